@@ -1,13 +1,43 @@
 #include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <fstream>
+#include <thread>
+#include <atomic>
 #include <vector>
 #include <cstring>
+#include <string>
 #include <deque>
-
-#define MAX_FRAMES 128
-#define MAX_VPAGES 64
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <unordered_map>
+#include <climits>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#define MAX_FRAMES (1 << 25) // limited by the width of pte_t::frame_num
+#define VPAGE_BITS 36                  // 48-bit virtual addresses with 4KB pages
+#define MAX_VPAGES (1LL << VPAGE_BITS)
+#define PT_PRINT_VPAGES 64             // vpages always listed by print_page_tables(), higher ones only when in use
+#define PT_LEVELS 4                    // levels of the radix page table
+#define PT_INDEX_BITS 9                // vpage bits resolved per level
+#define PT_FANOUT (1 << PT_INDEX_BITS) // entries per directory / leaf table
+#define VMT_MAGIC "VMT"           // magic bytes of the binary trace format, followed by a '\0'
+#define VMT_VERSION 2              // current version of the binary trace format
+#define STREAM_BUFFER_SIZE 65536 // instructions held by each of the two streaming buffers
+#define PARSE_CHUNK_MIN_SIZE (1 << 20) // smallest text chunk (in bytes) handed to a parser thread
 #define NRU_RESET_COUNT 48
 #define WORKING_SET_TAU 49
+#define PFF_WINDOW 256                 // own load/stores over which a process's page fault frequency is measured
+#define PFF_UPPER 8                    // faults per window above which a process is granted more frames
+#define PFF_LOWER 2                    // faults per window below which a process gives frames up
+#define SHARDS_MODULUS (1ULL << 24)    // range of the page hashes compared against the sampling threshold
+#define SHARDS_MAX_PAGES 8192          // distinct pages kept by the sampled miss-ratio curve
 
 #define CTX_SWITCH_TIME 130
 #define LD_ST_TIME 1
@@ -24,52 +54,80 @@
 
 using namespace std;
 
+typedef long long vpage_t; // virtual page number, -1 if none
+
+typedef struct pte_t pte_t;
+
 typedef struct frame_t {
-    frame_t() : is_assigned(false), pid(-1), vpage(-1), frame_id(-1), is_victim(false), age(0) {}
+    frame_t() : is_assigned(false), pid(-1), vpage(-1), frame_id(-1), is_victim(false), age(0), pte(nullptr),
+                lru_prev(-1), lru_next(-1) {}
 
     bool is_assigned;
     int pid;
-    int vpage;
+    vpage_t vpage;
     int frame_id;
     bool is_victim;
     unsigned long int age;
+    pte_t *pte;        // page table entry currently mapped to this frame
+    int lru_prev;      // more recently used neighbour in the LRUPager list, -1 if none
+    int lru_next;      // less recently used neighbour in the LRUPager list, -1 if none
 } frame_t;
 
-typedef struct {
+// the referenced (R) and modified (M) bits of a present page are kept per frame in Simulator::ref_bits/mod_bits
+typedef struct pte_t {
     unsigned int is_present: 1;         // is the v_page a valid/present page
-    unsigned int is_referenced: 1;      // is the v_page referenced
-    unsigned int is_modified: 1;        // is the v_page modified/written
     unsigned int is_write_protected: 1; // is the corresponding VMA write protected
     unsigned int is_paged_out: 1;       // is the v_page paged_out
 
     unsigned int is_assigned_to_vma: 1; // is the v_page a part of one of the VMAs
     unsigned int is_file_mapped: 1;     // is the corresponding VMA mapped to a file
 
-    unsigned int frame_num: 7; // frame_num can be at max 128 = 2^7 => 7 bits
+    unsigned int frame_num: 25; // frame_num can be at max 2^25 - 1 => 25 bits, the PTE still fits in 32 bits
 } pte_t;
 
 typedef struct {
-    unsigned int start_page: 6;         // max value is 2^6 = 64 (max no. of vpages)
-    unsigned int end_page: 6;           // max value is 2^6 = 64 (max no. of vpages)
-    unsigned int is_write_protected: 1; // is VMA write protected
-    unsigned int is_file_mapped: 1;     // is VMA file mapped
+    unsigned long long start_page: VPAGE_BITS;  // first vpage of the VMA
+    unsigned long long is_write_protected: 1;   // is VMA write protected
+    unsigned long long is_file_mapped: 1;       // is VMA file mapped
+    unsigned long long end_page: VPAGE_BITS;    // last vpage of the VMA (inclusive)
 } vma_t;
 
 typedef struct {
-    char op;  // opcode
-    int addr; // address
+    char op: 8;          // opcode
+    long long addr: 56;  // address (virtual page number or process number)
 } ins_t;
 
+typedef struct {
+    const char *data; // start of the read-only mapping
+    size_t size;      // length of the mapping in bytes
+} mapped_file_t;
+
+typedef struct {
+    const char *cur;                 // cursor into the mapping
+    const char *end;                 // end of the mapping
+    bool is_binary;                  // trace is in the binary (.vmt) format
+    unsigned long long remaining;    // binary only: instructions left to decode
+    long long prev_vpage;            // binary only: last decoded load/store page (base of the next delta)
+    int version;                     // binary only: format version of the trace
+    char prev_op;                    // binary only: opcode of the last decoded load/store
+    unsigned int repeats;            // binary only: repeats of the last load/store still to be returned
+} trace_reader_t;
+
+/**
+ * Pack a (pid, vpage) pair into a single key
+ */
+inline unsigned long long page_key(int pid, vpage_t vpage) {
+    return (unsigned long long) pid << VPAGE_BITS | (unsigned long long) vpage;
+}
+
 /**
  * Global variables part 1
  */
-frame_t FRAME_TABLE[MAX_FRAMES]; // global frame table to keep track of all the frames in the physical memory
-deque<frame_t *> FREE_FRAMES;    // list of free frames
-int NUM_FRAMES = 0;              // total number of frames in the frame_table
-int NUM_PROCS = 0;               // total number of
+int NUM_FRAMES = 0;              // number of frames given with -f
+int NUM_PROCS = 0;               // total number of processes in the input
+vector<vector<vma_t>> PROC_VMAS; // VMAs of each process in the input
 int RAND_COUNT = 0;              // total number of random numbers in file
 vector<int> RANDVALS;            // initialize a list of random numbers
-int OFS = 0;                     // line offset for the random file
 
 /**
  * List of option flags
@@ -79,24 +137,268 @@ bool SHOW_PAGE_TABLE = false;
 bool SHOW_FRAME_TABLE = false;
 bool SHOW_STATS = false;
 bool SHOW_AGING_INFO = false;
+bool STREAM_INSTRUCTIONS = false;
+bool USE_INVERTED_PAGE_TABLE = false;
+const char *PAGER_ARGS = nullptr;     // -a argument, the pager of the simulation
+const char *CONVERT_OUTPUT = nullptr; // write the input as a binary trace to this file instead of simulating
+int NUM_THREADS = 1;                  // threads used to parse a preloaded text trace and to run a sweep
+vector<string> SWEEP_PAGERS;          // -a arguments of the sweep configurations, empty if not sweeping
+vector<string> SWEEP_FRAMES;          // -f arguments of the sweep configurations
+char MRC_MODE = 0;                    // print a miss-ratio curve instead of simulating: 'e' exact, 's' sampled
 [[maybe_unused]] bool SHOW_CURR_PT = false;
 [[maybe_unused]] bool SHOW_PROCESS_PT = false;
 [[maybe_unused]] bool SHOW_CURR_FT = false;
 
-unsigned long long int INS_COUNTER = 0;     // instruction counter
-unsigned long long int CTX_SWITCHES = 0;    // total context switches
-unsigned long long int PROC_EXITS = 0;      // total process exits
-unsigned long long int COST = 0;            // total cost
+/**
+ * x86-64 style 4-level radix page table
+ * Directories and leaf tables are only allocated when a page below them is first touched,
+ * so memory grows with the touched part of the virtual address space rather than with its size.
+ * The most recently used leaf table is remembered to skip the walk for neighbouring pages.
+ */
+class PageTable {
+private:
+    typedef struct {
+        pte_t entries[PT_FANOUT];
+    } pt_leaf_t;
+
+    typedef struct {
+        void *children[PT_FANOUT]; // pt_dir_t * above level 1, pt_leaf_t * at level 1
+    } pt_dir_t;
+
+    pt_dir_t *root;
+    vpage_t cached_base;    // first vpage covered by cached_leaf
+    pt_leaf_t *cached_leaf;
+
+    static unsigned int index_at(vpage_t vpage, int level) {
+        return (vpage >> (PT_INDEX_BITS * level)) & (PT_FANOUT - 1);
+    }
+
+    pt_leaf_t *find_leaf(vpage_t vpage, bool allocate) {
+        vpage_t base = vpage & ~(vpage_t) (PT_FANOUT - 1);
+        if (cached_leaf != nullptr && cached_base == base)
+            return cached_leaf;
+
+        pt_dir_t *dir = root;
+        for (int level = PT_LEVELS - 1; level > 0; level--) {
+            void *&child = dir->children[index_at(vpage, level)];
+            if (child == nullptr) {
+                if (!allocate) return nullptr;
+                child = level > 1 ? (void *) new pt_dir_t() : (void *) new pt_leaf_t();
+            }
+            if (level > 1)
+                dir = (pt_dir_t *) child;
+            else
+                cached_leaf = (pt_leaf_t *) child;
+        }
+        cached_base = base;
+        return cached_leaf;
+    }
+
+    static void free_dir(pt_dir_t *dir, int level) {
+        for (void *child: dir->children) {
+            if (child == nullptr) continue;
+            if (level > 1)
+                free_dir((pt_dir_t *) child, level - 1);
+            else
+                delete (pt_leaf_t *) child;
+        }
+        delete dir;
+    }
+
+    template<typename Fn>
+    static void visit_dir(pt_dir_t *dir, int level, vpage_t base, Fn &fn) {
+        for (int i = 0; i < PT_FANOUT; i++) {
+            void *child = dir->children[i];
+            if (child == nullptr) continue;
+            vpage_t child_base = base | ((vpage_t) i << (PT_INDEX_BITS * level));
+            if (level > 1) {
+                visit_dir((pt_dir_t *) child, level - 1, child_base, fn);
+            } else {
+                auto *leaf = (pt_leaf_t *) child;
+                for (int j = 0; j < PT_FANOUT; j++)
+                    fn(child_base | j, &leaf->entries[j]);
+            }
+        }
+    }
+
+public:
+    PageTable() : root(new pt_dir_t()), cached_base(-1), cached_leaf(nullptr) {}
+
+    PageTable(const PageTable &) = delete;
+
+    PageTable &operator=(const PageTable &) = delete;
+
+    ~PageTable() {
+        free_dir(root, PT_LEVELS - 1);
+    }
+
+    /**
+     * Look up the entry of a vpage without allocating anything
+     * @return pte_t* - the entry, nullptr if the vpage was never touched (or is out of range)
+     */
+    pte_t *find(vpage_t vpage) {
+        if (vpage < 0 || vpage >= MAX_VPAGES) return nullptr;
+        pt_leaf_t *leaf = find_leaf(vpage, false);
+        return leaf == nullptr ? nullptr : &leaf->entries[vpage & (PT_FANOUT - 1)];
+    }
+
+    /**
+     * Walk to the entry of a vpage, allocating the missing levels on the way
+     * Entries stay at the same address until clear() is called
+     */
+    pte_t *walk(vpage_t vpage) {
+        return &find_leaf(vpage, true)->entries[vpage & (PT_FANOUT - 1)];
+    }
+
+    /**
+     * Call fn(vpage, pte) for every entry of every allocated leaf table, in vpage order
+     */
+    template<typename Fn>
+    void for_each(Fn fn) {
+        visit_dir(root, PT_LEVELS - 1, 0, fn);
+    }
+
+    /**
+     * Release all the levels below the root
+     */
+    void clear() {
+        free_dir(root, PT_LEVELS - 1);
+        root = new pt_dir_t();
+        cached_base = -1;
+        cached_leaf = nullptr;
+    }
+};
+
+/**
+ * Global hashed inverted page table (-i)
+ * Resident pages are found through an open-addressing hash table keyed by (pid, vpage) with linear probing,
+ * sized to twice the number of frames, and their entries live in a frame-indexed array.
+ * Non-resident pages keep no entry at all: their VMA details are looked up again on every fault and only
+ * the fact that a page has a copy in swap is remembered, so memory is bounded by the physical frames plus
+ * the swapped-out pages instead of the touched virtual footprint.
+ */
+class InvertedPageTable {
+private:
+    static constexpr unsigned long long EMPTY_KEY = ~0ULL;
+
+    typedef struct {
+        unsigned long long key;
+        int frame_id;
+    } ipt_bucket_t;
+
+    vector<ipt_bucket_t> buckets;
+    unsigned long long mask;
+    int hash_shift;
+    vector<pte_t> entries;                    // entry of the page resident in each frame
+    pte_t staging;                            // entry of the page currently being faulted in
+    unordered_set<unsigned long long> swapped; // non-resident pages with a copy in swap
+
+    size_t home(unsigned long long key) const {
+        return (key * 0x9E3779B97F4A7C15ULL) >> hash_shift;
+    }
+
+public:
+    explicit InvertedPageTable(int num_frames) : staging() {
+        int bits = 1;
+        while ((1ULL << bits) < 2ULL * num_frames)
+            bits++;
+        buckets.assign(1ULL << bits, {EMPTY_KEY, -1});
+        mask = (1ULL << bits) - 1;
+        hash_shift = 64 - bits;
+        entries.assign(num_frames, pte_t());
+    }
+
+    /**
+     * @return pte_t* - the entry of a resident page, nullptr if the page is not resident
+     */
+    pte_t *find(int pid, vpage_t vpage) {
+        unsigned long long key = page_key(pid, vpage);
+        for (size_t i = home(key);; i = (i + 1) & mask) {
+            if (buckets[i].key == key) return &entries[buckets[i].frame_id];
+            if (buckets[i].key == EMPTY_KEY) return nullptr;
+        }
+    }
+
+    /**
+     * Prepare a scratch entry for a page that is about to be faulted in
+     */
+    pte_t *stage(int pid, vpage_t vpage) {
+        staging = pte_t();
+        staging.is_paged_out = swapped.count(page_key(pid, vpage));
+        return &staging;
+    }
+
+    /**
+     * Move the staged entry into the frame it was given
+     * @return pte_t* - the entry of the now resident page
+     */
+    pte_t *install(int pid, vpage_t vpage, int frame_id) {
+        unsigned long long key = page_key(pid, vpage);
+        size_t i = home(key);
+        while (buckets[i].key != EMPTY_KEY)
+            i = (i + 1) & mask;
+        buckets[i] = {key, frame_id};
+        swapped.erase(key);
+        entries[frame_id] = staging;
+        return &entries[frame_id];
+    }
+
+    /**
+     * Drop the page resident in a frame, remembering whether it has a copy in swap
+     */
+    void evict(const frame_t *frame) {
+        unsigned long long key = page_key(frame->pid, frame->vpage);
+        if (entries[frame->frame_id].is_paged_out)
+            swapped.insert(key);
+
+        size_t i = home(key);
+        while (buckets[i].key != key)
+            i = (i + 1) & mask;
+
+        // backward-shift deletion keeps the probe sequences intact without tombstones
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; buckets[j].key != EMPTY_KEY; j = (j + 1) & mask) {
+            size_t h = home(buckets[j].key);
+            if (((j - h) & mask) >= ((j - hole) & mask)) {
+                buckets[hole] = buckets[j];
+                hole = j;
+            }
+        }
+        buckets[hole] = {EMPTY_KEY, -1};
+    }
+
+    /**
+     * Forget the swap copies of an exited process
+     */
+    void release_swap(int pid) {
+        for (auto it = swapped.begin(); it != swapped.end();) {
+            if ((int) (*it >> VPAGE_BITS) == pid)
+                it = swapped.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    /**
+     * @return vector - the swapped-out vpages of a process, unordered
+     */
+    vector<vpage_t> swapped_pages(int pid) const {
+        vector<vpage_t> pages;
+        for (unsigned long long key: swapped)
+            if ((int) (key >> VPAGE_BITS) == pid)
+                pages.push_back((vpage_t) (key & ((1ULL << VPAGE_BITS) - 1)));
+        return pages;
+    }
+};
 
 class Process {
 private:
-    static int process_count;
     int pid;
 
 public:
     int num_vmas;
     vector<vma_t> vma_list;
-    pte_t page_table[MAX_VPAGES]{0};
+    PageTable page_table;
 
     unsigned long long unmaps;
     unsigned long long maps;
@@ -108,10 +410,7 @@ public:
     unsigned long long segv;
     unsigned long long segprot;
 
-    Process() {
-        pid = Process::process_count;
-        Process::process_count++;
-        num_vmas = 0;
+    Process(int pid, const vector<vma_t> &vmas) : pid(pid), num_vmas((int) vmas.size()), vma_list(vmas) {
         unmaps = maps = ins = outs = fins = fouts = zeros = segv = segprot = 0;
     }
 
@@ -120,164 +419,509 @@ public:
     }
 };
 
-int Process::process_count = 0; // initializing the static int - process_count
-vector<Process *> PROCS;        // initialize a list of processes
-
 /**
- * Helper function to get the Page table entry given the frame_id
- *
- * @param id - frame id (can be used to access into the FRAME_TABLE)
- * @return pte_t* - the corresponding page table entry
+ * @return the bits of frame bitmap word w that fall in the frame range [from, to)
  */
-pte_t *reverse_map(int id) {
-    int pid = FRAME_TABLE[id].pid;
-    int vpage = FRAME_TABLE[id].vpage;
-    return &PROCS[pid]->page_table[vpage];
+inline unsigned long long frame_word_mask(int w, int from, int to) {
+    int hi = min(to - w * 64, 64);
+    int lo = max(from - w * 64, 0);
+    return (hi == 64 ? ~0ULL : (1ULL << hi) - 1) & (~0ULL << lo);
 }
 
+class Pager;
+
 /**
- * Get random number from randvals
- * @param - burst - the corresponding CPU or IO burst
- *
- * @returns - random value in the range of 1,..,burst
+ * The state of one simulation over the loaded input
+ * The input itself (INSTRUCTIONS, PROC_VMAS, RANDVALS) is only read, so any number of simulators can run over
+ * the trace at the same time, each with its own frames, processes and pager. Every run reads the instructions
+ * through an InstructionCursor of its own, which in streaming mode maps and parses the trace separately.
+ * Pagers reach the state through the simulator they were created for.
  */
-int get_random() {
-    int offset = OFS % RAND_COUNT;
-    int random = RANDVALS[offset] % NUM_FRAMES;
-    OFS++;
-    return random;
-}
+class Simulator {
+public:
+    int num_frames;                      // total number of frames in the frame_table
+    vector<frame_t> frame_table;         // frame table to keep track of all the frames in the physical memory
+    vector<unsigned long long> ref_bits; // referenced (R) bit of the page in each frame, 64 frames per word
+    vector<unsigned long long> mod_bits; // modified (M) bit of the page in each frame, 64 frames per word
+    deque<frame_t *> free_frames;        // list of free frames
+    vector<Process *> procs;             // processes of the input, indexed by pid
+    Process *curr_proc;                  // pointer to the current running process
+    Pager *pager;                        // pager instance used in the simulation
+    InvertedPageTable *ipt;              // translation structure when -i is given, nullptr otherwise
+    int ofs;                             // line offset for the random file
+    bool quiet;                          // do not print the process exits
+
+    unsigned long long int ins_counter;  // instruction counter
+    unsigned long long int ctx_switches; // total context switches
+    unsigned long long int proc_exits;   // total process exits
+    unsigned long long int cost;         // total cost
+
+    /**
+     * An empty simulator without frames, processes or pager, e.g. to check pager arguments against
+     */
+    Simulator() : num_frames(0), curr_proc(nullptr), pager(nullptr), ipt(nullptr), ofs(0), quiet(false),
+                  ins_counter(0), ctx_switches(0), proc_exits(0), cost(0) {}
+
+    Simulator(int frames, const char *pager_args);
+
+    Simulator(const Simulator &) = delete;
+
+    Simulator &operator=(const Simulator &) = delete;
+
+    ~Simulator();
+
+    /**
+     * Helper function to get the Page table entry given the frame_id
+     *
+     * @param id - frame id (can be used to access into the frame_table)
+     * @return pte_t* - the corresponding page table entry
+     */
+    pte_t *reverse_map(int id) {
+        return frame_table[id].pte;
+    }
+
+    /**
+     * Helper functions for the referenced (R) and modified (M) bits of the page mapped to a frame
+     */
+    bool is_frame_referenced(int id) const {
+        return (ref_bits[id >> 6] >> (id & 63)) & 1;
+    }
+
+    void set_frame_referenced(int id) {
+        ref_bits[id >> 6] |= 1ULL << (id & 63);
+    }
+
+    void clear_frame_referenced(int id) {
+        ref_bits[id >> 6] &= ~(1ULL << (id & 63));
+    }
+
+    bool is_frame_modified(int id) const {
+        return (mod_bits[id >> 6] >> (id & 63)) & 1;
+    }
+
+    void set_frame_modified(int id) {
+        mod_bits[id >> 6] |= 1ULL << (id & 63);
+    }
+
+    void clear_frame_modified(int id) {
+        mod_bits[id >> 6] &= ~(1ULL << (id & 63));
+    }
+
+    /**
+     * @return int - the first frame in [from, to) whose R bit is clear, or -1
+     */
+    int find_unreferenced_frame(int from, int to) const {
+        for (int w = from >> 6; w * 64 < to; w++) {
+            unsigned long long bits = ~ref_bits[w] & frame_word_mask(w, from, to);
+            if (bits) return w * 64 + __builtin_ctzll(bits);
+        }
+        return -1;
+    }
+
+    /**
+     * Clear the R bits of the frames in [from, to)
+     */
+    void clear_frames_referenced(int from, int to) {
+        for (int w = from >> 6; w * 64 < to; w++)
+            ref_bits[w] &= ~frame_word_mask(w, from, to);
+    }
+
+    /**
+     * Get random number from randvals
+     * @param - burst - the corresponding CPU or IO burst
+     *
+     * @returns - random value in the range of 1,..,burst
+     */
+    int get_random() {
+        int offset = ofs % RAND_COUNT;
+        int random = RANDVALS[offset] % num_frames;
+        ofs++;
+        return random;
+    }
+
+    void run_simulation();
+
+    void print_output();
+
+    string sweep_row(const string &pager_args, const string &frames) const;
+
+private:
+    void initialize_frames();
+
+    frame_t *allocate_frame_from_free_list();
+
+    frame_t *get_frame();
+
+    void handle_context_switch(long long target);
+
+    pte_t *find_pte(Process *proc, vpage_t vpage);
+
+    pte_t *check_validity_and_cache_details(vpage_t vpage);
+
+    void unmap_victim_frame(frame_t *victim);
+
+    void handle_load_store(char op, vpage_t vpage);
+
+    void release_exited_frame(frame_t *frame);
+
+    void handle_process_exit(long long target);
+
+    void print_pte(vpage_t vpage, const pte_t &entry) const;
+
+    void print_page_tables();
+
+    void print_frame_table();
+
+    void print_per_process_stats();
+
+    void print_global_stats();
+};
 
 class Pager {
+protected:
+    Simulator &sim; // simulation whose frames the pager manages
+
 public:
+    explicit Pager(Simulator &sim) : sim(sim) {}
+
     virtual frame_t *select_victim_frame() = 0;
 
     virtual void reset_age(unsigned int frame_id) = 0;
 
+    /**
+     * Called on every load/store to the page in the frame, after reset_age() if the access has just mapped it
+     * @param faulted - the access faulted the page in rather than hitting it
+     */
+    virtual void note_reference(unsigned int frame_id, bool faulted) {}
+
+    /**
+     * Called once the input is loaded and the frames are initialized, before the simulation starts
+     */
+    virtual void prepare() {}
+
+    /**
+     * Called when a valid vpage of the current process faults, before a frame is requested for it
+     */
+    virtual void note_fault(int pid, vpage_t vpage) {}
+
+    /**
+     * Called when a frame goes back to the free list because its process exited
+     */
+    virtual void release_frame(unsigned int frame_id) {}
+
+    /**
+     * Called after the global stats are printed, for statistics of the pager itself
+     */
+    virtual void print_stats() {}
+
     virtual ~Pager() = default;
 };
 
+/**
+ * A set of doubly-linked lists over small integer ids (frame ids or pager-owned node ids),
+ * every id being on at most one of them
+ * Front is the most recently inserted end, all operations are O(1)
+ */
+class FrameLists {
+private:
+    vector<int> prev;
+    vector<int> next;
+    vector<int> owner; // list the frame is on, -1 if none
+    vector<int> heads;
+    vector<int> tails;
+    vector<int> sizes;
+
+public:
+    explicit FrameLists(int num_lists) : heads(num_lists, -1), tails(num_lists, -1), sizes(num_lists, 0) {}
+
+    void resize(int num_ids) {
+        prev.assign(num_ids, -1);
+        next.assign(num_ids, -1);
+        owner.assign(num_ids, -1);
+    }
+
+    int list_of(int id) const { return owner[id]; }
+
+    int size(int list) const { return sizes[list]; }
+
+    int front(int list) const { return heads[list]; }
+
+    int back(int list) const { return tails[list]; }
+
+    int next_of(int id) const { return next[id]; }
+
+    void push_front(int list, int id) {
+        prev[id] = -1;
+        next[id] = heads[list];
+        if (heads[list] != -1) prev[heads[list]] = id;
+        else tails[list] = id;
+        heads[list] = id;
+        owner[id] = list;
+        sizes[list]++;
+    }
+
+    void push_back(int list, int id) {
+        next[id] = -1;
+        prev[id] = tails[list];
+        if (tails[list] != -1) next[tails[list]] = id;
+        else heads[list] = id;
+        tails[list] = id;
+        owner[id] = list;
+        sizes[list]++;
+    }
+
+    void remove(int id) {
+        int list = owner[id];
+        if (list == -1) return;
+        if (prev[id] != -1) next[prev[id]] = next[id];
+        else heads[list] = next[id];
+        if (next[id] != -1) prev[next[id]] = prev[id];
+        else tails[list] = prev[id];
+        prev[id] = next[id] = owner[id] = -1;
+        sizes[list]--;
+    }
+};
+
+/**
+ * Recency-ordered set of non-resident pages, keyed by page_key()
+ * Front is the most recently inserted end, all operations are O(1)
+ */
+class GhostList {
+private:
+    list<unsigned long long> keys;
+    unordered_map<unsigned long long, list<unsigned long long>::iterator> index;
+
+public:
+    size_t size() const { return keys.size(); }
+
+    bool contains(unsigned long long key) const { return index.count(key) > 0; }
+
+    void push_front(unsigned long long key) {
+        keys.push_front(key);
+        index[key] = keys.begin();
+    }
+
+    void remove(unsigned long long key) {
+        auto it = index.find(key);
+        if (it == index.end()) return;
+        keys.erase(it->second);
+        index.erase(it);
+    }
+
+    void pop_back() {
+        if (keys.empty()) return;
+        index.erase(keys.back());
+        keys.pop_back();
+    }
+};
+
 class FCFSPager : public Pager {
 private:
     int curr_idx;
 public:
-    FCFSPager() {
+    explicit FCFSPager(Simulator &sim) : Pager(sim) {
         curr_idx = 0;
     }
 
     void reset_age(unsigned int frame_id) override {}
 
     frame_t *select_victim_frame() override {
-        frame_t *victim = &FRAME_TABLE[curr_idx];
+        frame_t *victim = &sim.frame_table[curr_idx];
         if (SHOW_AGING_INFO) printf("ASELECT %d\n", curr_idx);
-        curr_idx = (curr_idx + 1) % NUM_FRAMES;
+        curr_idx = (curr_idx + 1) % sim.num_frames;
         return victim;
     }
 };
 
 class RandomPager : public Pager {
 public:
+    using Pager::Pager;
+
     frame_t *select_victim_frame() override {
-        int index = get_random();
-        return &FRAME_TABLE[index];
+        int index = sim.get_random();
+        return &sim.frame_table[index];
     }
 
     void reset_age(unsigned int frame_id) override {}
 };
 
+/**
+ * Clock
+ * The hand moves over the R bitmap a word at a time: it clears the R bits of up to 64 referenced frames
+ * at once and finds the first unreferenced frame with ctz.
+ */
 class ClockPager : public Pager {
 private:
     int clock_idx;
+
+    /**
+     * Move the hand over [from, to), clearing R bits until the first unreferenced frame
+     * @return int - the first unreferenced frame in [from, to), or -1 if every R bit in the range was cleared
+     */
+    int sweep(int from, int to) {
+        int idx = sim.find_unreferenced_frame(from, to);
+        sim.clear_frames_referenced(from, idx == -1 ? to : idx);
+        return idx;
+    }
+
 public:
-    ClockPager() {
+    explicit ClockPager(Simulator &sim) : Pager(sim) {
         clock_idx = 0;
     }
 
     frame_t *select_victim_frame() override {
         int start = clock_idx;
-        int count = 0;
-        pte_t *clock_pte = reverse_map(clock_idx);
-        count++;
-        while (clock_pte->is_referenced) {
-            clock_pte->is_referenced = false;
-            clock_idx = (clock_idx + 1) % NUM_FRAMES;
-            clock_pte = reverse_map(clock_idx);
-            count++;
+        int victim_idx = sweep(start, sim.num_frames);
+        if (victim_idx == -1)
+            victim_idx = sweep(0, start);
+
+        int count;
+        if (victim_idx == -1) {
+            // every frame was referenced, the hand went full circle back to start
+            victim_idx = start;
+            count = sim.num_frames + 1;
+        } else {
+            count = (victim_idx - start + sim.num_frames) % sim.num_frames + 1;
         }
 
         if (SHOW_AGING_INFO) printf("ASELECT %d %d\n", start, count);
-        frame_t *victim = &FRAME_TABLE[clock_idx];
-        clock_idx = (clock_idx + 1) % NUM_FRAMES;
+        frame_t *victim = &sim.frame_table[victim_idx];
+        clock_idx = (victim_idx + 1) % sim.num_frames;
         return victim;
     }
 
     void reset_age(unsigned int frame_id) override {}
 };
 
+/**
+ * Two-handed clock (SVR4 style)
+ * The front hand runs spread frames ahead of the back hand and clears R bits; the back hand takes the
+ * first frame that is still unreferenced. Both hands move one frame per step, so a frame the back hand
+ * reaches spread steps into a scan has just been cleared and a scan is at most spread + 1 frames long.
+ * Select with -a t<spread>, the spread defaults to a quarter of the frames.
+ */
+class TwoHandClockPager : public Pager {
+private:
+    int back_hand;
+    int spread;
+
+    /**
+     * @return int - offset of the first unreferenced frame within count frames from start (wrapping around),
+     * or -1
+     */
+    int find_unreferenced_after(int start, int count) const {
+        int idx = sim.find_unreferenced_frame(start, min(sim.num_frames, start + count));
+        if (idx == -1 && start + count > sim.num_frames)
+            idx = sim.find_unreferenced_frame(0, start + count - sim.num_frames);
+        return idx == -1 ? -1 : (idx - start + sim.num_frames) % sim.num_frames;
+    }
+
+    void clear_referenced_after(int start, int count) {
+        sim.clear_frames_referenced(start, min(sim.num_frames, start + count));
+        if (start + count > sim.num_frames)
+            sim.clear_frames_referenced(0, start + count - sim.num_frames);
+    }
+
+public:
+    TwoHandClockPager(Simulator &sim, int spread) : Pager(sim), back_hand(0), spread(spread) {}
+
+    void prepare() override {
+        if (spread < 0)
+            spread = sim.num_frames / 4;
+        spread = min(spread, sim.num_frames - 1);
+    }
+
+    frame_t *select_victim_frame() override {
+        int start = back_hand;
+        int front_hand = (back_hand + spread) % sim.num_frames;
+
+        // the back hand checks frame start + step after the front hand cleared front_hand + step
+        int steps = find_unreferenced_after(start, spread);
+        if (steps == -1)
+            steps = spread;
+        clear_referenced_after(front_hand, steps + 1);
+
+        int victim_idx = (start + steps) % sim.num_frames;
+        if (SHOW_AGING_INFO) printf("ASELECT %d %d %d\n", start, front_hand, steps + 1);
+        back_hand = (victim_idx + 1) % sim.num_frames;
+        return &sim.frame_table[victim_idx];
+    }
+
+    void reset_age(unsigned int frame_id) override {}
+};
+
+/**
+ * Not Recently Used
+ * The four R/M classes are derived a word at a time from the R and M bitmaps, so the first
+ * frame of a class at or after the hand is found with a ctz per 64 frames, and the periodic reset clears
+ * every R bit at once. All frames are in use whenever a victim is selected.
+ */
 class NRUPager : public Pager {
 private:
     int reset_cycle;
     unsigned long long int last_reset;
     int hand;
 
-public:
-    NRUPager() : hand(0), last_reset(0), reset_cycle(NRU_RESET_COUNT) {}
+    /**
+     * @return the frames of word w that are in the given class (2 * R + M)
+     */
+    unsigned long long class_word(int page_class, int w) const {
+        unsigned long long r = sim.ref_bits[w];
+        unsigned long long m = sim.mod_bits[w];
+        unsigned long long bits = (page_class & 2 ? r : ~r) & (page_class & 1 ? m : ~m);
+        if (w == sim.num_frames / 64)
+            bits &= (1ULL << (sim.num_frames & 63)) - 1;
+        return bits;
+    }
 
-    static int get_class_index(pte_t *pte) {
-        int r = pte->is_referenced;
-        int m = pte->is_modified;
-        return 2 * r + m;
+    /**
+     * @return int - the first frame at or after the hand (wrapping around) in the given class, or -1
+     */
+    int find_class_frame(int page_class) const {
+        int words = (int) sim.ref_bits.size();
+        int first_word = hand / 64;
+        for (int i = 0; i <= words; i++) {
+            int w = (first_word + i) % words;
+            unsigned long long bits = class_word(page_class, w);
+            if (i == 0)
+                bits &= ~0ULL << (hand & 63);
+            else if (i == words)
+                bits &= (1ULL << (hand & 63)) - 1;
+            if (bits)
+                return w * 64 + __builtin_ctzll(bits);
+        }
+        return -1;
     }
 
-    frame_t *select_victim_frame() override {
-        int class_frame_map[4] = {-1, -1, -1, -1};
+public:
+    explicit NRUPager(Simulator &sim) : Pager(sim), hand(0), last_reset(0), reset_cycle(NRU_RESET_COUNT) {}
 
+    frame_t *select_victim_frame() override {
         // variables for ASELECT
         int start = hand;
-        bool reset = INS_COUNTER >= (last_reset + reset_cycle);
-        int lowest_class_found = -1;
+        bool reset = sim.ins_counter >= (last_reset + reset_cycle);
+        int lowest_class_found = 0;
         int victim_frame_id = -1;
-        int scan_count = 0;
 
-        for (int i = 0; i < NUM_FRAMES; i++) {
-            scan_count++;
-            int idx = (hand + i) % NUM_FRAMES;
-            pte_t *pte = reverse_map(idx);
-            int page_type = get_class_index(pte);
-
-            if (class_frame_map[page_type] == -1) {
-                class_frame_map[page_type] = idx;
-            }
+        for (; lowest_class_found < 4; lowest_class_found++) {
+            victim_frame_id = find_class_frame(lowest_class_found);
+            if (victim_frame_id != -1) break;
+        }
 
-            if (page_type == 0 && !reset) {
-                victim_frame_id = idx;
-                lowest_class_found = 0;
-                break;
-            }
+        // a scan stops at the first class 0 frame unless it also has to reset every R bit
+        int scan_count = sim.num_frames;
+        if (lowest_class_found == 0 && !reset)
+            scan_count = (victim_frame_id - hand + sim.num_frames) % sim.num_frames + 1;
 
-            if (reset) {
-                pte->is_referenced = false;
-            }
-        }
-
-        if (lowest_class_found == -1) {
-            for (int i = 0; i < 4; i++) {
-                if (class_frame_map[i] != -1) {
-                    victim_frame_id = class_frame_map[i];
-                    lowest_class_found = i;
-                    break;
-                }
-            }
-        }
-
-        frame_t *victim = &FRAME_TABLE[victim_frame_id];
+        frame_t *victim = &sim.frame_table[victim_frame_id];
         if (SHOW_AGING_INFO) {
             printf("ASELECT: hand=%2d %d | %d %2d %2d\n", start, reset, lowest_class_found, victim_frame_id,
                    scan_count);
         }
-        hand = (victim_frame_id + 1) % NUM_FRAMES;
+        hand = (victim_frame_id + 1) % sim.num_frames;
         if (reset) {
-            last_reset = INS_COUNTER;
+            fill(sim.ref_bits.begin(), sim.ref_bits.end(), 0);
+            last_reset = sim.ins_counter;
         }
         return victim;
     }
@@ -285,454 +929,2653 @@ public:
     void reset_age(unsigned int frame_id) override {}
 };
 
+/**
+ * Aging kernels over a packed age array
+ * age_pass shifts every age right by one, ORs in the frame's R bit as the top bit and returns the smallest
+ * resulting age; find_age returns the first index in [from, to) holding the given age, or -1. The AVX2 and
+ * AVX-512 variants are picked at runtime, the scalar ones are used everywhere else.
+ */
+typedef unsigned int (*age_pass_fn)(unsigned int *ages, const unsigned long long *ref_bits, int n);
+typedef int (*find_age_fn)(const unsigned int *ages, int from, int to, unsigned int age);
+
+unsigned int age_pass_scalar(unsigned int *ages, const unsigned long long *ref_bits, int n, int from,
+                             unsigned int min_age) {
+    for (int i = from; i < n; i++) {
+        unsigned int r = (ref_bits[i >> 6] >> (i & 63)) & 1;
+        ages[i] = (ages[i] >> 1) | (r << 31);
+        min_age = min(min_age, ages[i]);
+    }
+    return min_age;
+}
+
+unsigned int age_pass_scalar(unsigned int *ages, const unsigned long long *ref_bits, int n) {
+    return age_pass_scalar(ages, ref_bits, n, 0, UINT_MAX);
+}
+
+int find_age_scalar(const unsigned int *ages, int from, int to, unsigned int age) {
+    for (int i = from; i < to; i++)
+        if (ages[i] == age) return i;
+    return -1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+unsigned int age_pass_avx2(unsigned int *ages, const unsigned long long *ref_bits, int n) {
+    const unsigned char *ref_bytes = (const unsigned char *) ref_bits;
+    const __m256i bit_of_lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i top_bit = _mm256_set1_epi32((int) 0x80000000);
+    __m256i min_ages = _mm256_set1_epi32(-1);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i r = _mm256_and_si256(_mm256_set1_epi32(ref_bytes[i >> 3]), bit_of_lane);
+        __m256i r_mask = _mm256_cmpeq_epi32(r, bit_of_lane);
+        __m256i a = _mm256_loadu_si256((const __m256i *) (ages + i));
+        a = _mm256_or_si256(_mm256_srli_epi32(a, 1), _mm256_and_si256(r_mask, top_bit));
+        _mm256_storeu_si256((__m256i *) (ages + i), a);
+        min_ages = _mm256_min_epu32(min_ages, a);
+    }
+    unsigned int lanes[8];
+    _mm256_storeu_si256((__m256i *) lanes, min_ages);
+    unsigned int min_age = *min_element(lanes, lanes + 8);
+    return age_pass_scalar(ages, ref_bits, n, i, min_age);
+}
+
+__attribute__((target("avx2")))
+int find_age_avx2(const unsigned int *ages, int from, int to, unsigned int age) {
+    const __m256i wanted = _mm256_set1_epi32((int) age);
+    int i = from;
+    for (; i + 8 <= to; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (ages + i));
+        int hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, wanted)));
+        if (hits) return i + __builtin_ctz(hits);
+    }
+    return find_age_scalar(ages, i, to, age);
+}
+
+// the AVX-512 headers of some GCC versions trip -Wmaybe-uninitialized on _mm512_undefined_epi32()
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+unsigned int age_pass_avx512(unsigned int *ages, const unsigned long long *ref_bits, int n) {
+    const unsigned short *ref_words = (const unsigned short *) ref_bits;
+    const __m512i top_bit = _mm512_set1_epi32((int) 0x80000000);
+    __m512i min_ages = _mm512_set1_epi32(-1);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i a = _mm512_srli_epi32(_mm512_loadu_si512(ages + i), 1);
+        a = _mm512_mask_or_epi32(a, (__mmask16) ref_words[i >> 4], a, top_bit);
+        _mm512_storeu_si512(ages + i, a);
+        min_ages = _mm512_min_epu32(min_ages, a);
+    }
+    unsigned int lanes[16];
+    _mm512_storeu_si512(lanes, min_ages);
+    unsigned int min_age = *min_element(lanes, lanes + 16);
+    return age_pass_scalar(ages, ref_bits, n, i, min_age);
+}
+
+__attribute__((target("avx512f")))
+int find_age_avx512(const unsigned int *ages, int from, int to, unsigned int age) {
+    const __m512i wanted = _mm512_set1_epi32((int) age);
+    int i = from;
+    for (; i + 16 <= to; i += 16) {
+        __mmask16 hits = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(ages + i), wanted);
+        if (hits) return i + __builtin_ctz(hits);
+    }
+    return find_age_scalar(ages, i, to, age);
+}
+#pragma GCC diagnostic pop
+#endif
+
+/**
+ * Aging
+ * Ages live in a packed array next to the R bitmap and are advanced in one of two ways. While
+ * only a few pages are referenced between faults, shifts are applied lazily: a frame's age is stored
+ * together with the tick (aging pass) it was last ORed into, only frames referenced since the previous pass
+ * are touched, and every other age is implicitly shifted right once per elapsed tick. An age that got its
+ * top bit at tick t is larger than any age that got it at an earlier tick, and it has decayed to 0 after
+ * 32 ticks, so the minimum is either the first zero-age ("cold") frame after the hand or lies in the bucket
+ * of the oldest tick. Once a pass would touch more than an eighth of the frames, every age is kept current
+ * instead and each pass runs the vectorized kernels above; the pager drops back to lazy shifts when fewer
+ * than 1/32 of the frames were referenced. Selection is identical to shifting every frame on every fault.
+ */
 class AgingPager : public Pager {
 private:
+    static constexpr int AGE_BITS = 32;
+
     int hand;
-public:
-    AgingPager() : hand(0) {}
+    bool dense;                               // every age is current and passes run the kernels
+    age_pass_fn age_pass;
+    find_age_fn find_age;
+    unsigned long long tick;                  // number of aging passes so far
+    vector<unsigned int> ages;                // age of each frame as of its age_tick (as of now when dense)
+    vector<unsigned long long> age_tick;      // tick at which the age was last brought up to date
+    vector<bool> is_cold;                     // the age has decayed (or been reset) to 0
+    vector<bool> is_dirty;                    // frame is on the dirty list
+    vector<int> dirty;                        // frames referenced since the last pass
+    set<int> cold;                            // frames with age 0
+    map<unsigned long long, vector<int>> buckets; // non-cold frames by age_tick, may hold stale entries
+
+    unsigned long current_age(int idx) const {
+        if (dense) return ages[idx];
+        if (is_cold[idx]) return 0;
+        unsigned long long shift = tick - age_tick[idx];
+        return shift >= AGE_BITS ? 0 : ages[idx] >> shift;
+    }
 
-    frame_t *select_victim_frame() override {
-        int start_idx = hand;
-        int min_age_idx = hand;
+    bool in_bucket(int idx, unsigned long long bucket_tick) const {
+        return !is_cold[idx] && age_tick[idx] == bucket_tick;
+    }
+
+    void make_cold(int idx) {
+        ages[idx] = 0;
+        age_tick[idx] = tick;
+        is_cold[idx] = true;
+        cold.insert(idx);
+    }
+
+    /**
+     * Apply one lazy aging pass: fold in the reference bits of the dirty frames and let old ages decay to 0
+     */
+    void advance_tick() {
+        tick++;
+
+        for (int idx: dirty) {
+            is_dirty[idx] = false;
+            if (!sim.is_frame_referenced(idx)) continue;
+
+            // current_age() already includes this tick's shift
+            ages[idx] = current_age(idx) | 0x80000000;
+            sim.clear_frame_referenced(idx);
+            if (is_cold[idx]) {
+                is_cold[idx] = false;
+                cold.erase(idx);
+            }
+            age_tick[idx] = tick;
+            buckets[tick].push_back(idx);
+        }
+        dirty.clear();
+
+        while (!buckets.empty() && buckets.begin()->first + AGE_BITS <= tick) {
+            for (int idx: buckets.begin()->second)
+                if (in_bucket(idx, buckets.begin()->first))
+                    make_cold(idx);
+            buckets.erase(buckets.begin());
+        }
+    }
+
+    /**
+     * @return int - the first frame at or after the hand with the smallest age
+     */
+    int find_min_age_frame() {
+        if (!cold.empty()) {
+            auto it = cold.lower_bound(hand);
+            return it == cold.end() ? *cold.begin() : *it;
+        }
 
-        for (int i = 0; i < NUM_FRAMES; i++) {
-            int idx = (hand + i) % NUM_FRAMES;
+        while (true) {
+            auto bucket = buckets.begin();
+            vector<int> &members = bucket->second;
+            int best = -1;
+            unsigned long best_age = 0;
+            int best_dist = 0;
+            size_t live = 0;
+            for (int idx: members) {
+                if (!in_bucket(idx, bucket->first)) continue;
+                members[live++] = idx;
+                unsigned long age = current_age(idx);
+                int dist = (idx - hand + sim.num_frames) % sim.num_frames;
+                if (best == -1 || age < best_age || (age == best_age && dist < best_dist)) {
+                    best = idx;
+                    best_age = age;
+                    best_dist = dist;
+                }
+            }
+            members.resize(live);
+            if (best != -1) return best;
+            buckets.erase(bucket);
+        }
+    }
 
-            pte_t *pte = reverse_map(idx);
-            frame_t *frame = &FRAME_TABLE[idx];
+    /**
+     * Bring every age up to date and leave the lazy bookkeeping behind
+     */
+    void enter_dense() {
+        for (int idx = 0; idx < sim.num_frames; idx++)
+            ages[idx] = current_age(idx);
+        for (int idx: dirty)
+            is_dirty[idx] = false;
+        dirty.clear();
+        cold.clear();
+        buckets.clear();
+        dense = true;
+    }
 
-            // shift right by 1 (divide by 2)
-            frame->age >>= 1;
-            if (pte->is_referenced) {
-                // add the reference bit to left of age
-                frame->age |= 0x80000000;
-                // reset R bit
-                pte->is_referenced = false;
+    /**
+     * Rebuild the lazy bookkeeping from the current ages; an age whose top set bit is b positions below
+     * bit 31 got its top bit b ticks ago
+     */
+    void leave_dense() {
+        for (int idx = 0; idx < sim.num_frames; idx++) {
+            if (ages[idx] == 0) {
+                age_tick[idx] = tick;
+                is_cold[idx] = true;
+                cold.insert(idx);
+                continue;
             }
-            min_age_idx = FRAME_TABLE[idx].age < FRAME_TABLE[min_age_idx].age ? idx : min_age_idx;
+            int decay = __builtin_clz(ages[idx]);
+            ages[idx] <<= decay;
+            age_tick[idx] = tick - decay;
+            is_cold[idx] = false;
+            buckets[age_tick[idx]].push_back(idx);
+        }
+        dense = false;
+    }
+
+    /**
+     * Apply one aging pass to every frame
+     * @return int - the first frame at or after the hand with the smallest age
+     */
+    int dense_pass() {
+        tick++;
+        int referenced = 0;
+        for (unsigned long long word: sim.ref_bits)
+            referenced += __builtin_popcountll(word);
+
+        unsigned int min_age = age_pass(ages.data(), sim.ref_bits.data(), sim.num_frames);
+        fill(sim.ref_bits.begin(), sim.ref_bits.end(), 0);
+        int idx = find_age(ages.data(), hand, sim.num_frames, min_age);
+        if (idx == -1)
+            idx = find_age(ages.data(), 0, hand, min_age);
+
+        if (referenced < sim.num_frames / 32)
+            leave_dense();
+        return idx;
+    }
+
+public:
+    explicit AgingPager(Simulator &sim) : Pager(sim), hand(0), dense(false), age_pass(age_pass_scalar),
+                                          find_age(find_age_scalar), tick(0) {
+#if defined(__x86_64__) && defined(__GNUC__)
+        if (__builtin_cpu_supports("avx512f")) {
+            age_pass = age_pass_avx512;
+            find_age = find_age_avx512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            age_pass = age_pass_avx2;
+            find_age = find_age_avx2;
+        }
+#endif
+    }
+
+    void prepare() override {
+        ages.assign(sim.num_frames, 0);
+        age_tick.assign(sim.num_frames, 0);
+        is_cold.assign(sim.num_frames, true);
+        is_dirty.assign(sim.num_frames, false);
+    }
+
+    frame_t *select_victim_frame() override {
+        int start_idx = hand;
+        if (!dense && (int) dirty.size() > sim.num_frames / 8)
+            enter_dense();
+
+        int min_age_idx;
+        if (dense) {
+            min_age_idx = dense_pass();
+        } else {
+            advance_tick();
+            min_age_idx = find_min_age_frame();
         }
 
         if (SHOW_AGING_INFO) {
-            int end_idx = (start_idx + NUM_FRAMES - 1) % NUM_FRAMES;
+            int end_idx = (start_idx + sim.num_frames - 1) % sim.num_frames;
             printf("ASELECT %d-%d |", start_idx, end_idx);
 
-            for (int i = 0; i < NUM_FRAMES; i++) {
-                int idx = (start_idx + i) % NUM_FRAMES;
-                frame_t *frame = &FRAME_TABLE[idx];
-                printf(" %d:%lx", idx, frame->age);
+            for (int i = 0; i < sim.num_frames; i++) {
+                int idx = (start_idx + i) % sim.num_frames;
+                printf(" %d:%lx", idx, current_age(idx));
             }
 
             printf(" | %d\n", min_age_idx);
         }
 
-        frame_t *victim = &FRAME_TABLE[min_age_idx];
-        hand = (min_age_idx + 1) % NUM_FRAMES;
+        frame_t *victim = &sim.frame_table[min_age_idx];
+        hand = (min_age_idx + 1) % sim.num_frames;
         return victim;
     }
 
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        if (dense || is_dirty[frame_id]) return;
+        is_dirty[frame_id] = true;
+        dirty.push_back((int) frame_id);
+    }
+
     void reset_age(unsigned int frame_id) override {
-        frame_t *frame = &FRAME_TABLE[frame_id];
-        frame->age = 0;
+        if (dense || is_cold[frame_id])
+            ages[frame_id] = 0;
+        else
+            make_cold((int) frame_id);
     }
 };
 
+/**
+ * Working Set
+ * Every age update is appended to a FIFO of (age, frame) uses, and frames whose latest use is more than tau
+ * instructions old are moved into the old_bits bitmap as the FIFO drains. A victim is the first frame at or
+ * after the hand in old_bits & ~ref_bits, and the referenced frames the hand passes on the way get the
+ * current age. Without such a frame every referenced frame is refreshed and the oldest frame is taken from
+ * the FIFO front. The -oa output walks the frames one by one as the hand would, on the same bookkeeping.
+ */
 class WorkingSetPager : public Pager {
 private:
+    typedef struct {
+        unsigned long age;
+        int frame_id;
+    } use_t;
+
     int hand;
     int tau;
-public:
-    WorkingSetPager() : hand(0), tau(WORKING_SET_TAU) {}
+    deque<use_t> uses;                  // age updates oldest first, superseded ones are dropped lazily
+    vector<unsigned long long> old_bits; // frames last used more than tau instructions ago
 
-    frame_t *select_victim_frame() override {
-        int start_idx = hand;
-        int oldest_idx = hand;
+    bool is_current(const use_t &use) const {
+        return sim.frame_table[use.frame_id].age == use.age;
+    }
 
-        if (SHOW_AGING_INFO) {
-            int end_idx = (start_idx + NUM_FRAMES - 1) % NUM_FRAMES;
-            printf("ASELECT %d-%d |", start_idx, end_idx);
+    bool is_old(int idx) const {
+        return (old_bits[idx >> 6] >> (idx & 63)) & 1;
+    }
+
+    void touch(int idx) {
+        sim.frame_table[idx].age = sim.ins_counter;
+        old_bits[idx >> 6] &= ~(1ULL << (idx & 63));
+        uses.push_back({sim.frame_table[idx].age, idx});
+    }
+
+    /**
+     * Move the frames whose last use is now more than tau instructions ago into old_bits
+     */
+    void expire_uses() {
+        while (!uses.empty() && sim.ins_counter > uses.front().age + tau) {
+            int idx = uses.front().frame_id;
+            if (is_current(uses.front()))
+                old_bits[idx >> 6] |= 1ULL << (idx & 63);
+            uses.pop_front();
         }
+    }
 
-        int count = 0;
-        for (int i = 0; i < NUM_FRAMES; i++) {
-            count++;
-            int idx = (hand + i) % NUM_FRAMES;
+    /**
+     * @return int - the first old and unreferenced frame in [from, to), or -1
+     */
+    int find_old_frame(int from, int to) const {
+        for (int w = from >> 6; w * 64 < to; w++) {
+            unsigned long long bits = old_bits[w] & ~sim.ref_bits[w] & frame_word_mask(w, from, to);
+            if (bits) return w * 64 + __builtin_ctzll(bits);
+        }
+        return -1;
+    }
 
-            pte_t *pte = reverse_map(idx);
-            frame_t *frame = &FRAME_TABLE[idx];
+    /**
+     * Give every referenced frame in [from, to) the current age and clear its R bit
+     */
+    void refresh_referenced(int from, int to) {
+        for (int w = from >> 6; w * 64 < to; w++) {
+            unsigned long long range = frame_word_mask(w, from, to);
+            for (unsigned long long bits = sim.ref_bits[w] & range; bits; bits &= bits - 1)
+                touch(w * 64 + __builtin_ctzll(bits));
+            sim.ref_bits[w] &= ~range;
+        }
+    }
 
-            if (SHOW_AGING_INFO) {
-                printf(" %d(%d %d:%d %lu)", idx, pte->is_referenced, frame->pid, frame->vpage, frame->age - 1);
+    /**
+     * @return int - the first frame at or after the hand with the smallest age; every frame is on the FIFO
+     */
+    int find_oldest_frame() {
+        while (!is_current(uses.front()))
+            uses.pop_front();
+
+        unsigned long min_age = uses.front().age;
+        int oldest_idx = -1;
+        int oldest_dist = sim.num_frames;
+        for (auto it = uses.begin(); it != uses.end() && it->age == min_age; ++it) {
+            int dist = (it->frame_id - hand + sim.num_frames) % sim.num_frames;
+            if (is_current(*it) && dist < oldest_dist) {
+                oldest_idx = it->frame_id;
+                oldest_dist = dist;
             }
+        }
+        return oldest_idx;
+    }
+
+    /**
+     * Walk the frames from the hand one at a time, printing each of them
+     */
+    int scan_victim_frame() {
+        int start_idx = hand;
+        int oldest_idx = hand;
+        int end_idx = (start_idx + sim.num_frames - 1) % sim.num_frames;
+        printf("ASELECT %d-%d |", start_idx, end_idx);
+
+        int count = 0;
+        for (int i = 0; i < sim.num_frames; i++) {
+            count++;
+            int idx = (hand + i) % sim.num_frames;
+
+            bool is_referenced = sim.is_frame_referenced(idx);
+            frame_t *frame = &sim.frame_table[idx];
+            printf(" %d(%d %d:%lld %lu)", idx, is_referenced, frame->pid, frame->vpage, frame->age - 1);
 
-            bool is_old = INS_COUNTER > (frame->age + tau);
-            if (is_old && !pte->is_referenced) {
-                if (SHOW_AGING_INFO) printf(" STOP(%d)", count);
+            if (is_old(idx) && !is_referenced) {
+                printf(" STOP(%d)", count);
                 oldest_idx = idx;
                 break;
             }
 
-            if (pte->is_referenced) {
-                frame->age = INS_COUNTER;
-                pte->is_referenced = false;
+            if (is_referenced) {
+                touch(idx);
+                sim.clear_frame_referenced(idx);
             }
 
-            oldest_idx = FRAME_TABLE[idx].age < FRAME_TABLE[oldest_idx].age ? idx : oldest_idx;
+            oldest_idx = sim.frame_table[idx].age < sim.frame_table[oldest_idx].age ? idx : oldest_idx;
         }
 
+        printf(" | %d\n", oldest_idx);
+        return oldest_idx;
+    }
+
+public:
+    explicit WorkingSetPager(Simulator &sim) : Pager(sim), hand(0), tau(WORKING_SET_TAU) {}
+
+    void prepare() override {
+        old_bits.assign((sim.num_frames + 63) / 64, 0);
+    }
+
+    frame_t *select_victim_frame() override {
+        expire_uses();
+
+        int victim_idx;
         if (SHOW_AGING_INFO) {
-            printf(" | %d\n", oldest_idx);
+            victim_idx = scan_victim_frame();
+        } else if ((victim_idx = find_old_frame(hand, sim.num_frames)) != -1) {
+            refresh_referenced(hand, victim_idx);
+        } else if ((victim_idx = find_old_frame(0, hand)) != -1) {
+            refresh_referenced(hand, sim.num_frames);
+            refresh_referenced(0, victim_idx);
+        } else {
+            refresh_referenced(0, sim.num_frames);
+            victim_idx = find_oldest_frame();
         }
 
-        hand = (oldest_idx + 1) % NUM_FRAMES;
-        return &FRAME_TABLE[oldest_idx];
+        hand = (victim_idx + 1) % sim.num_frames;
+        return &sim.frame_table[victim_idx];
     }
 
     void reset_age(unsigned int frame_id) override {
-        frame_t *frame = &FRAME_TABLE[frame_id];
-        frame->age = INS_COUNTER;
+        touch((int) frame_id);
     }
 };
 
 /**
- * Global variables part 2
+ * WSClock with asynchronous write-back
+ * The hand skips frames whose write-back is in flight, clears the R bit of referenced frames (giving them the
+ * current age) and takes the first clean frame older than tau. An old dirty frame gets its write-back
+ * scheduled instead: its contents are snapshotted (M is cleared, an anonymous page now has a copy in swap)
+ * and it stays in flight for OUTS_TIME / FOUTS_TIME cycles of cost, overlapped with execution. Without an old
+ * clean frame after a full circle, the first clean frame, then the first frame that is not in flight (written
+ * synchronously at unmap as usual) is taken. One always exists: the frame mapped at the previous fault has its
+ * R bit set and no write-back in flight.
  */
-Pager *PAGER = nullptr;          // pager instance used in the simulation
-Process *CURR_PROC = nullptr;    // pointer to the current running process
-deque<ins_t> INSTRUCTIONS;       // list of instructions
+class WSClockPager : public Pager {
+private:
+    int hand;
+    int tau;
+    vector<unsigned long long> write_done;  // cost at which the frame's write-back completes
+    unsigned long async_outs;
+    unsigned long async_fouts;
 
-/**
- * Helper functions
- */
+    bool is_writing(int idx) const {
+        return write_done[idx] > sim.cost;
+    }
 
-/**
- * Initialize frames for the FRAME_TABLE
- */
-void initialize_frames() {
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        frame_t *frame = &FRAME_TABLE[i];
-        frame->frame_id = i;
+    void schedule_write_back(int idx) {
+        pte_t *pte = sim.reverse_map(idx);
+        sim.clear_frame_modified(idx);
+        if (pte->is_file_mapped) {
+            async_fouts++;
+            write_done[idx] = sim.cost + FOUTS_TIME;
+        } else {
+            pte->is_paged_out = true;
+            async_outs++;
+            write_done[idx] = sim.cost + OUTS_TIME;
+        }
+    }
+
+public:
+    explicit WSClockPager(Simulator &sim) : Pager(sim), hand(0), tau(WORKING_SET_TAU), async_outs(0), async_fouts(0) {}
 
-        FREE_FRAMES.push_back(frame);
+    void prepare() override {
+        write_done.assign(sim.num_frames, 0);
     }
-}
 
-/**
- * Allocate frame from free list
- * @return
- */
-frame_t *allocate_frame_from_free_list() {
-    if (FREE_FRAMES.empty()) return nullptr;
-    frame_t *free_frame = FREE_FRAMES.front();
-    FREE_FRAMES.pop_front();
-    return free_frame;
-}
+    frame_t *select_victim_frame() override {
+        int start = hand;
+        int victim_idx = -1;
+        int first_clean = -1;
+        int first_idle = -1;
+        int writes = 0;
+
+        for (int i = 0; i < sim.num_frames && victim_idx == -1; i++) {
+            int idx = (hand + i) % sim.num_frames;
+            if (is_writing(idx)) continue;
+
+            frame_t *frame = &sim.frame_table[idx];
+            if (sim.is_frame_referenced(idx)) {
+                sim.clear_frame_referenced(idx);
+                frame->age = sim.ins_counter;
+            } else if (sim.ins_counter > frame->age + tau) {
+                if (!sim.is_frame_modified(idx)) {
+                    victim_idx = idx;
+                    break;
+                }
+                schedule_write_back(idx);
+                writes++;
+                continue;
+            }
 
-/**
- * Get a frame from the frame table
- * @return frame to be associated with the virtual page
- */
-frame_t *get_frame() {
-    frame_t *frame = allocate_frame_from_free_list();
-    if (frame == nullptr)
-        frame = PAGER->select_victim_frame();
-    return frame;
-}
+            if (first_idle == -1) first_idle = idx;
+            if (first_clean == -1 && !sim.is_frame_modified(idx)) first_clean = idx;
+        }
 
-/**
- * Get the appropriate pager based on the arguments
- * @param - args - string that needs to parsed to fetch the pager type
- *
- * @returns - the correct Pager based on the arguments
- */
-Pager *getPager(char *args) {
-    switch (args[0]) {
-        case 'f':
-            return new FCFSPager();
-        case 'r':
-            return new RandomPager();
-        case 'c':
-            return new ClockPager();
-        case 'e':
-            return new NRUPager();
-        case 'a':
-            return new AgingPager();
-        case 'w':
-            return new WorkingSetPager();
-        default:
-            printf("Unknown Replacement Algorithm: %c\n", args[0]);
-            exit(1);
+        if (victim_idx == -1) victim_idx = first_clean;
+        if (victim_idx == -1) victim_idx = first_idle;
+        assert(victim_idx != -1);
+
+        if (SHOW_AGING_INFO) printf("ASELECT %d %d | %d\n", start, writes, victim_idx);
+        hand = (victim_idx + 1) % sim.num_frames;
+        return &sim.frame_table[victim_idx];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        sim.frame_table[frame_id].age = sim.ins_counter;
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        write_done[frame_id] = 0;
     }
-}
+
+    void print_stats() override {
+        printf("ASYNC OUTS=%lu FOUTS=%lu OVERLAPPED=%llu\n", async_outs, async_fouts,
+               (unsigned long long) async_outs * OUTS_TIME + (unsigned long long) async_fouts * FOUTS_TIME);
+    }
+};
 
 /**
- * Set the required output options from the arguments
- * @param - args - string that needs to parsed to fetch all the options that need to be set
- *
+ * Page Fault Frequency (variable allocation)
+ * Every process owns the frames its pages are in and replaces locally among them. When a process faults fewer than
+ * PFF_LOWER times in its last PFF_WINDOW load/stores, its frames not referenced since its previous fault become spare
+ * and all its R bits are cleared. A process faulting more than PFF_UPPER times per window is granted a frame instead,
+ * taken from the spare frames of the process below PFF_LOWER with the fewest faults. Without such a process the frame
+ * comes from the process with the fewest faults among those holding at least two frames more, so a large working set
+ * cannot keep a small one thrashing and two thrashing processes settle on even shares; a process that owns no frame
+ * takes one from the process with the fewest faults. Fault rates are measured in each process's own references (virtual
+ * time), so a process that is not running keeps the rate it had when it last ran.
  */
-void set_options(char *args) {
-    char *ch = args;
+class PFFPager : public Pager {
+private:
+    int faulting_pid;
+    FrameLists resident;                       // lists 2 * pid (in use) and 2 * pid + 1 (spare), newest first
+    vector<unsigned long long> vtime;          // load/stores executed by each process
+    vector<deque<unsigned long long>> faults;  // virtual times of each process's recent faults
+    vector<unsigned long> grants;              // frames granted to a process
+    vector<unsigned long> reclaims;            // frames reclaimed from a process
 
-    while (*ch != '\0') {
-        switch (*ch) {
-            case 'O':
-                VERBOSE = true;
-                break;
-            case 'P':
-                SHOW_PAGE_TABLE = true;
-                break;
-            case 'F':
-                SHOW_FRAME_TABLE = true;
-                break;
-            case 'S':
-                SHOW_STATS = true;
-                break;
-            case 'x':
-                SHOW_CURR_PT = true;
-                break;
-            case 'y':
-                SHOW_PROCESS_PT = true;
-                break;
-            case 'f':
-                SHOW_CURR_FT = true;
-                break;
-            case 'a':
-                SHOW_AGING_INFO = true;
-                break;
-            default:
-                printf("Unknown output option: <%c>\n", *ch);
-                exit(1);
+    static int in_use(int pid) { return 2 * pid; }
+
+    static int spare(int pid) { return 2 * pid + 1; }
+
+    int frames_of(int pid) const {
+        return resident.size(in_use(pid)) + resident.size(spare(pid));
+    }
+
+    int fault_rate(int pid) {
+        deque<unsigned long long> &times = faults[pid];
+        while (!times.empty() && times.front() + PFF_WINDOW <= vtime[pid])
+            times.pop_front();
+        return (int) times.size();
+    }
+
+    /**
+     * Move the frames of a process that were not referenced since its previous fault to its spare list
+     */
+    void shrink(int pid) {
+        for (int idx = resident.front(in_use(pid)); idx != -1;) {
+            int next = resident.next_of(idx);
+            if (!sim.is_frame_referenced(idx)) {
+                resident.remove(idx);
+                resident.push_front(spare(pid), idx);
+            }
+            sim.clear_frame_referenced(idx);
+            idx = next;
         }
-        ch++;
     }
+
+    /**
+     * @return int - the oldest spare frame of a process that is still unreferenced, or -1
+     */
+    int take_spare(int pid) {
+        while (resident.size(spare(pid)) > 0) {
+            int idx = resident.back(spare(pid));
+            if (!sim.is_frame_referenced(idx))
+                return idx;
+            resident.remove(idx);
+            resident.push_front(in_use(pid), idx);
+        }
+        return -1;
+    }
+
+    /**
+     * Second chance over the frames of a process, spare frames first
+     */
+    int select_local_frame(int pid) {
+        int idx = take_spare(pid);
+        while (idx == -1) {
+            int oldest = resident.back(in_use(pid));
+            resident.remove(oldest);
+            resident.push_front(in_use(pid), oldest);
+            if (!sim.is_frame_referenced(oldest))
+                idx = oldest;
+            sim.clear_frame_referenced(oldest);
+        }
+        return idx;
+    }
+
+    /**
+     * @return int - the process other than pid with the fewest faults among those below PFF_LOWER that have a
+     * spare frame, or -1
+     */
+    int find_donor(int pid) {
+        int donor = -1;
+        int donor_rate = PFF_LOWER;
+        for (int q = 0; q < NUM_PROCS; q++) {
+            if (q == pid) continue;
+            int rate = fault_rate(q);
+            if (rate < donor_rate && take_spare(q) != -1) {
+                donor = q;
+                donor_rate = rate;
+            }
+        }
+        return donor;
+    }
+
+    /**
+     * @return int - the process with the fewest faults among those holding at least two frames more than pid,
+     * or -1
+     */
+    int find_larger_owner(int pid) {
+        int owner = -1;
+        int owner_rate = INT_MAX;
+        for (int q = 0; q < NUM_PROCS; q++) {
+            if (q == pid || frames_of(q) < frames_of(pid) + 2) continue;
+            int rate = fault_rate(q);
+            if (rate < owner_rate) {
+                owner = q;
+                owner_rate = rate;
+            }
+        }
+        return owner;
+    }
+
+    /**
+     * @return int - the process other than pid with the fewest faults among those that own a frame, or -1
+     */
+    int find_any_owner(int pid) {
+        int owner = -1;
+        int owner_rate = INT_MAX;
+        for (int q = 0; q < NUM_PROCS; q++) {
+            if (q == pid || frames_of(q) == 0) continue;
+            int rate = fault_rate(q);
+            if (rate < owner_rate) {
+                owner = q;
+                owner_rate = rate;
+            }
+        }
+        return owner;
+    }
+
+public:
+    explicit PFFPager(Simulator &sim) : Pager(sim), faulting_pid(-1), resident(0) {}
+
+    void prepare() override {
+        resident = FrameLists(2 * NUM_PROCS);
+        resident.resize(sim.num_frames);
+        vtime.assign(NUM_PROCS, 0);
+        faults.assign(NUM_PROCS, deque<unsigned long long>());
+        grants.assign(NUM_PROCS, 0);
+        reclaims.assign(NUM_PROCS, 0);
+    }
+
+    void note_fault(int pid, vpage_t vpage) override {
+        faulting_pid = pid;
+        if (fault_rate(pid) < PFF_LOWER)
+            shrink(pid);
+        faults[pid].push_back(vtime[pid]);
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        vtime[sim.frame_table[frame_id].pid]++;
+    }
+
+    frame_t *select_victim_frame() override {
+        int pid = faulting_pid;
+        int rate = fault_rate(pid);
+        int owner = pid;
+        if (rate > PFF_UPPER || frames_of(pid) == 0) {
+            int donor = find_donor(pid);
+            if (donor == -1 && rate > PFF_UPPER)
+                donor = find_larger_owner(pid);
+            if (donor == -1 && frames_of(pid) == 0)
+                donor = find_any_owner(pid);
+            if (donor != -1) {
+                owner = donor;
+                grants[pid]++;
+                reclaims[donor]++;
+            }
+        }
+
+        int victim_idx = select_local_frame(owner);
+        if (SHOW_AGING_INFO) printf("ASELECT %d %d | %d %d\n", pid, rate, owner, victim_idx);
+        return &sim.frame_table[victim_idx];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        resident.remove((int) frame_id);
+        resident.push_front(in_use(sim.frame_table[frame_id].pid), (int) frame_id);
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        resident.remove((int) frame_id);
+    }
+
+    void print_stats() override {
+        for (int pid = 0; pid < NUM_PROCS; pid++) {
+            printf("PFF PROC[%d]: FRAMES=%d GRANTED=%lu RECLAIMED=%lu\n", pid, frames_of(pid), grants[pid],
+                   reclaims[pid]);
+        }
+    }
+};
+
+/**
+ * Exact LRU: the frames form a recency list threaded through frame_t (lru_prev / lru_next),
+ * every reference moves its frame to the head and the victim is taken from the tail, all in O(1).
+ */
+class LRUPager : public Pager {
+private:
+    int head; // most recently used frame
+    int tail; // least recently used frame
+
+    void unlink(frame_t *frame) {
+        if (frame->lru_prev != -1)
+            sim.frame_table[frame->lru_prev].lru_next = frame->lru_next;
+        else
+            head = frame->lru_next;
+        if (frame->lru_next != -1)
+            sim.frame_table[frame->lru_next].lru_prev = frame->lru_prev;
+        else
+            tail = frame->lru_prev;
+        frame->lru_prev = frame->lru_next = -1;
+    }
+
+    void push_head(frame_t *frame) {
+        frame->lru_next = head;
+        if (head != -1)
+            sim.frame_table[head].lru_prev = frame->frame_id;
+        head = frame->frame_id;
+        if (tail == -1)
+            tail = frame->frame_id;
+    }
+
+public:
+    explicit LRUPager(Simulator &sim) : Pager(sim), head(-1), tail(-1) {}
+
+    frame_t *select_victim_frame() override {
+        frame_t *victim = &sim.frame_table[tail];
+        if (SHOW_AGING_INFO) printf("ASELECT %d\n", tail);
+        return victim;
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        frame_t *frame = &sim.frame_table[frame_id];
+        if (head == (int) frame_id)
+            return;
+        if (frame->lru_prev != -1)
+            unlink(frame);
+        push_head(frame);
+    }
+
+    void reset_age(unsigned int frame_id) override {}
+};
+
+/**
+ * Adaptive Replacement Cache (Megiddo & Modha)
+ * Resident pages seen once recently sit on T1, pages seen at least twice on T2; B1 and B2 remember the
+ * pages recently evicted from each of them. Hits in B1 grow the target size p of T1, hits in B2 shrink it,
+ * and the victim comes from T1 or T2 depending on p.
+ * Evictions only happen once the free list is empty, processes giving back frames on exit can leave
+ * the lists below their usual sizes.
+ */
+class ARCPager : public Pager {
+private:
+    enum { T1, T2 };
+
+    FrameLists lists;
+    GhostList b1;
+    GhostList b2;
+    int target_t1;      // adaptive target size p of T1
+    int pending_list;   // list the page being faulted in goes to
+    bool hit_b2;        // the page being faulted in was found in B2
+    bool discard_t1;    // T1 alone fills the cache: its LRU page is dropped without a ghost entry
+
+    unsigned long long frame_key(int frame_id) const {
+        return page_key(sim.frame_table[frame_id].pid, sim.frame_table[frame_id].vpage);
+    }
+
+public:
+    explicit ARCPager(Simulator &sim) : Pager(sim), lists(2), target_t1(0), pending_list(T1), hit_b2(false),
+                                        discard_t1(false) {}
+
+    void prepare() override {
+        lists.resize(sim.num_frames);
+    }
+
+    void note_fault(int pid, vpage_t vpage) override {
+        unsigned long long key = page_key(pid, vpage);
+        int c = sim.num_frames;
+        hit_b2 = false;
+        discard_t1 = false;
+
+        if (b1.contains(key)) {
+            int delta = max(1, (int) (b2.size() / b1.size()));
+            target_t1 = min(c, target_t1 + delta);
+            b1.remove(key);
+            pending_list = T2;
+        } else if (b2.contains(key)) {
+            int delta = max(1, (int) (b1.size() / b2.size()));
+            target_t1 = max(0, target_t1 - delta);
+            b2.remove(key);
+            hit_b2 = true;
+            pending_list = T2;
+        } else {
+            pending_list = T1;
+            size_t l1 = lists.size(T1) + b1.size();
+            size_t total = l1 + lists.size(T2) + b2.size();
+            if (l1 >= (size_t) c) {
+                if (lists.size(T1) < c)
+                    b1.pop_back();
+                else
+                    discard_t1 = true;
+            } else if (total >= 2 * (size_t) c) {
+                b2.pop_back();
+            }
+        }
+    }
+
+    frame_t *select_victim_frame() override {
+        int victim;
+        int t1 = lists.size(T1);
+        bool from_t1 = t1 > 0 && (discard_t1 || t1 > target_t1 || (hit_b2 && t1 == target_t1));
+        if (lists.size(T2) == 0) from_t1 = true;
+
+        if (from_t1) {
+            victim = lists.back(T1);
+            if (!discard_t1) b1.push_front(frame_key(victim));
+        } else {
+            victim = lists.back(T2);
+            b2.push_front(frame_key(victim));
+        }
+        lists.remove(victim);
+
+        if (SHOW_AGING_INFO) printf("ASELECT %d T%d p=%d\n", victim, from_t1 ? 1 : 2, target_t1);
+        return &sim.frame_table[victim];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        lists.remove((int) frame_id);
+        lists.push_front(pending_list, (int) frame_id);
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        if (faulted) return;
+        lists.remove((int) frame_id);
+        lists.push_front(T2, (int) frame_id);
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        lists.remove((int) frame_id);
+    }
+};
+
+/**
+ * CLOCK-Pro (Jiang, Chen & Zhang)
+ * One clock ring holds resident hot pages, resident cold pages and non-resident cold pages that are still in
+ * their test period. HAND_cold evicts cold pages, promoting those re-referenced during their test period;
+ * HAND_hot demotes unreferenced hot pages and ends test periods; HAND_test bounds the non-resident pages
+ * to NUM_FRAMES. The share of cold pages (cold_target) adapts: it grows when a page is re-referenced during
+ * its test period and shrinks when a test period runs out. Reference bits are the frames' R bits.
+ * Resident cold pages enter the ring next to HAND_hot, so HAND_cold meets them in the order they became
+ * cold; it runs over a queue of their frames in that order instead of the ring, which keeps it from
+ * stepping over the hot and test pages when cold_target is small.
+ */
+class ClockProPager : public Pager {
+private:
+    typedef struct {
+        unsigned long long key; // page_key() of the page
+        int frame_id;           // -1 for a non-resident page
+        bool is_hot;
+        bool in_test;           // cold page in its test period
+        int prev;
+        int next;
+    } cp_node_t;
+
+    vector<cp_node_t> nodes;
+    vector<int> free_nodes;
+    vector<int> frame_node;                         // node of the page resident in each frame
+    unordered_map<unsigned long long, int> non_resident; // non-resident test pages by key
+    FrameLists cold;                                // frames of the resident cold pages, newest at the front
+    int hand_hot;
+    int hand_test;
+    int count_hot;
+    int count_cold;
+    int count_test;
+    int cold_target;
+    bool pending_hot; // the page being faulted in was a non-resident test page
+
+    int hot_target() const {
+        return sim.num_frames - cold_target;
+    }
+
+    bool is_referenced(int n) {
+        return sim.is_frame_referenced(nodes[n].frame_id);
+    }
+
+    void clear_referenced(int n) {
+        sim.clear_frame_referenced(nodes[n].frame_id);
+    }
+
+    int alloc_node() {
+        if (free_nodes.empty()) {
+            nodes.emplace_back();
+            return (int) nodes.size() - 1;
+        }
+        int n = free_nodes.back();
+        free_nodes.pop_back();
+        return n;
+    }
+
+    /**
+     * Insert at the list head, which is the position HAND_hot reaches last
+     */
+    void insert_at_head(int n) {
+        if (hand_hot == -1) {
+            nodes[n].prev = nodes[n].next = n;
+            hand_hot = hand_test = n;
+            return;
+        }
+        int tail = nodes[hand_hot].prev;
+        nodes[n].prev = tail;
+        nodes[n].next = hand_hot;
+        nodes[tail].next = n;
+        nodes[hand_hot].prev = n;
+    }
+
+    void unlink(int n) {
+        int next = nodes[n].next;
+        if (next == n) {
+            hand_hot = hand_test = -1;
+            return;
+        }
+        if (hand_hot == n) hand_hot = next;
+        if (hand_test == n) hand_test = next;
+        nodes[nodes[n].prev].next = next;
+        nodes[next].prev = nodes[n].prev;
+    }
+
+    void drop_node(int n) {
+        unlink(n);
+        free_nodes.push_back(n);
+    }
+
+    /**
+     * A cold page leaves its test period without having been re-referenced
+     */
+    void end_test_period(int n) {
+        nodes[n].in_test = false;
+        cold_target = max(1, cold_target - 1);
+        if (nodes[n].frame_id == -1) {
+            non_resident.erase(nodes[n].key);
+            count_test--;
+            drop_node(n);
+        }
+    }
+
+    /**
+     * Move HAND_hot until one hot page has been demoted to cold
+     */
+    void run_hand_hot() {
+        while (count_hot > 0) {
+            int n = hand_hot;
+            hand_hot = nodes[n].next;
+            if (nodes[n].is_hot) {
+                if (is_referenced(n)) {
+                    clear_referenced(n);
+                    continue;
+                }
+                nodes[n].is_hot = false;
+                count_hot--;
+                count_cold++;
+                cold.push_front(0, nodes[n].frame_id);
+                return;
+            }
+            if (nodes[n].in_test)
+                end_test_period(n);
+        }
+    }
+
+    /**
+     * Move HAND_test until the number of non-resident pages is back within bounds
+     */
+    void run_hand_test() {
+        while (count_test > sim.num_frames) {
+            int n = hand_test;
+            hand_test = nodes[n].next;
+            if (!nodes[n].is_hot && nodes[n].in_test)
+                end_test_period(n);
+        }
+    }
+
+    /**
+     * Move HAND_cold until a resident cold page without its reference bit set has been evicted
+     * @return int - frame of the evicted page
+     */
+    int run_hand_cold() {
+        while (true) {
+            if (count_cold == 0) {
+                run_hand_hot();
+                continue;
+            }
+
+            int frame_id = cold.back(0);
+            int n = frame_node[frame_id];
+            cold.remove(frame_id);
+
+            if (is_referenced(n)) {
+                clear_referenced(n);
+                if (nodes[n].in_test) {
+                    // re-referenced during its test period: the page becomes hot
+                    cold_target = min(max(1, sim.num_frames - 1), cold_target + 1);
+                    nodes[n].is_hot = true;
+                    nodes[n].in_test = false;
+                    count_cold--;
+                    count_hot++;
+                } else {
+                    nodes[n].in_test = true;
+                    cold.push_front(0, frame_id);
+                }
+                unlink(n);
+                insert_at_head(n);
+                if (count_hot > hot_target())
+                    run_hand_hot();
+                continue;
+            }
+
+            frame_node[frame_id] = -1;
+            count_cold--;
+            if (nodes[n].in_test) {
+                // keep the page around as non-resident until its test period ends
+                nodes[n].frame_id = -1;
+                non_resident[nodes[n].key] = n;
+                count_test++;
+                run_hand_test();
+            } else {
+                drop_node(n);
+            }
+            return frame_id;
+        }
+    }
+
+public:
+    explicit ClockProPager(Simulator &sim) : Pager(sim), cold(1), hand_hot(-1), hand_test(-1), count_hot(0),
+                                             count_cold(0), count_test(0), cold_target(1), pending_hot(false) {}
+
+    void prepare() override {
+        frame_node.assign(sim.num_frames, -1);
+        cold.resize(sim.num_frames);
+        nodes.reserve(2 * sim.num_frames + 1);
+    }
+
+    void note_fault(int pid, vpage_t vpage) override {
+        pending_hot = false;
+        auto it = non_resident.find(page_key(pid, vpage));
+        if (it == non_resident.end())
+            return;
+
+        // faulted in again during its test period: the page comes back hot
+        int n = it->second;
+        non_resident.erase(it);
+        count_test--;
+        drop_node(n);
+        cold_target = min(max(1, sim.num_frames - 1), cold_target + 1);
+        pending_hot = true;
+    }
+
+    frame_t *select_victim_frame() override {
+        int start = cold.back(0);
+        int victim = run_hand_cold();
+        if (SHOW_AGING_INFO) {
+            printf("ASELECT %d %d | hot=%d cold=%d test=%d mc=%d\n", start, victim, count_hot, count_cold,
+                   count_test, cold_target);
+        }
+        return &sim.frame_table[victim];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        int n = alloc_node();
+        nodes[n].key = page_key(sim.frame_table[frame_id].pid, sim.frame_table[frame_id].vpage);
+        nodes[n].frame_id = (int) frame_id;
+        nodes[n].is_hot = pending_hot || count_hot < hot_target();
+        nodes[n].in_test = !nodes[n].is_hot;
+        nodes[n].is_hot ? count_hot++ : count_cold++;
+        if (!nodes[n].is_hot) cold.push_front(0, (int) frame_id);
+        insert_at_head(n);
+        frame_node[frame_id] = n;
+        pending_hot = false;
+
+        if (count_hot > hot_target())
+            run_hand_hot();
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        // the faulting access is not a re-reference
+        if (!faulted) return;
+        sim.clear_frame_referenced((int) frame_id);
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        int n = frame_node[frame_id];
+        if (n == -1) return;
+        nodes[n].is_hot ? count_hot-- : count_cold--;
+        cold.remove((int) frame_id);
+        frame_node[frame_id] = -1;
+        drop_node(n);
+    }
+};
+
+/**
+ * Low Inter-reference Recency Set (Jiang & Zhang)
+ * Pages with a low inter-reference recency (LIR) stay resident, the rest (HIR) compete for a small share of
+ * the frames. Stack S orders LIR pages and recently seen HIR pages (resident or not) by recency and is pruned
+ * so that its bottom is always a LIR page; queue Q holds the resident HIR pages in eviction order.
+ * A HIR page referenced again while still on S has a lower recency than the bottom LIR page and swaps
+ * status with it. Non-resident HIR entries are kept on S up to 2 * NUM_FRAMES, oldest dropped first.
+ */
+class LIRSPager : public Pager {
+private:
+    enum { Q, NON_RESIDENT };
+
+    vector<unsigned long long> keys;  // per node: page_key() of the page
+    vector<int> node_frame;           // per node: frame of the page, -1 if non-resident
+    vector<bool> node_lir;            // per node: the page is LIR
+    vector<int> free_nodes;
+    vector<int> frame_node;           // node of the page resident in each frame
+    unordered_map<unsigned long long, int> index;
+    FrameLists stack;                 // S, top at the front
+    FrameLists queues;                // Q (resident HIR) and the non-resident HIR entries of S, newest at the front
+    int count_lir;
+    int lir_target;                   // L_lirs
+    unsigned long long pending_key;   // page being faulted in
+
+    bool on_stack(int n) const {
+        return stack.list_of(n) != -1;
+    }
+
+    void drop_node(int n) {
+        stack.remove(n);
+        queues.remove(n);
+        index.erase(keys[n]);
+        free_nodes.push_back(n);
+    }
+
+    /**
+     * Remove the HIR entries at the bottom of S
+     */
+    void prune() {
+        while (stack.size(0) > 0) {
+            int bottom = stack.back(0);
+            if (node_lir[bottom]) return;
+            stack.remove(bottom);
+            if (node_frame[bottom] == -1)
+                drop_node(bottom);
+        }
+    }
+
+    /**
+     * Turn the bottom LIR page of S into a resident HIR page
+     */
+    void demote_bottom_lir() {
+        int bottom = stack.back(0);
+        if (bottom == -1 || !node_lir[bottom]) return;
+        node_lir[bottom] = false;
+        count_lir--;
+        stack.remove(bottom);
+        queues.remove(bottom);
+        queues.push_front(Q, bottom);
+        prune();
+    }
+
+    void make_lir(int n) {
+        node_lir[n] = true;
+        count_lir++;
+        queues.remove(n);
+        stack.remove(n);
+        stack.push_front(0, n);
+        if (count_lir > lir_target)
+            demote_bottom_lir();
+    }
+
+public:
+    explicit LIRSPager(Simulator &sim) : Pager(sim), stack(1), queues(2), count_lir(0), lir_target(0), pending_key(0) {}
+
+    void prepare() override {
+        int num_nodes = 3 * sim.num_frames + 2;
+        keys.assign(num_nodes, 0);
+        node_frame.assign(num_nodes, -1);
+        node_lir.assign(num_nodes, false);
+        for (int n = num_nodes - 1; n >= 0; n--)
+            free_nodes.push_back(n);
+        frame_node.assign(sim.num_frames, -1);
+        stack.resize(num_nodes);
+        queues.resize(num_nodes);
+        // at least one LIR page, otherwise a single frame never holds one and S can never be pruned
+        lir_target = max(1, sim.num_frames - max(1, sim.num_frames / 100));
+    }
+
+    void note_fault(int pid, vpage_t vpage) override {
+        pending_key = page_key(pid, vpage);
+    }
+
+    frame_t *select_victim_frame() override {
+        int victim = queues.back(Q);
+        if (victim == -1) {
+            // no resident HIR page (frames given back by exits): fall back to the bottom LIR page
+            demote_bottom_lir();
+            victim = queues.back(Q);
+        }
+
+        int frame_id = node_frame[victim];
+        assert(frame_id >= 0);
+        frame_node[frame_id] = -1;
+        node_frame[victim] = -1;
+        queues.remove(victim);
+        if (on_stack(victim)) {
+            queues.push_front(NON_RESIDENT, victim);
+            if (queues.size(NON_RESIDENT) > 2 * sim.num_frames) {
+                drop_node(queues.back(NON_RESIDENT));
+                prune();
+            }
+        } else {
+            drop_node(victim);
+        }
+
+        if (SHOW_AGING_INFO) {
+            printf("ASELECT %d | lir=%d hir=%d nonres=%d\n", frame_id, count_lir, queues.size(Q),
+                   queues.size(NON_RESIDENT));
+        }
+        return &sim.frame_table[frame_id];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        auto it = index.find(pending_key);
+        int n;
+        if (it != index.end()) {
+            // non-resident HIR page still on S: its recency beats the bottom LIR page
+            n = it->second;
+            queues.remove(n);
+            node_frame[n] = (int) frame_id;
+            make_lir(n);
+        } else {
+            n = free_nodes.back();
+            free_nodes.pop_back();
+            keys[n] = pending_key;
+            node_frame[n] = (int) frame_id;
+            node_lir[n] = false;
+            index[pending_key] = n;
+            if (count_lir < lir_target) {
+                make_lir(n);
+            } else {
+                stack.push_front(0, n);
+                queues.push_front(Q, n);
+            }
+        }
+        frame_node[frame_id] = n;
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        if (faulted) return;
+        int n = frame_node[frame_id];
+        if (node_lir[n]) {
+            stack.remove(n);
+            stack.push_front(0, n);
+            prune();
+        } else if (on_stack(n)) {
+            make_lir(n);
+        } else {
+            stack.push_front(0, n);
+            queues.remove(n);
+            queues.push_front(Q, n);
+        }
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        int n = frame_node[frame_id];
+        if (n == -1) return;
+        if (node_lir[n]) count_lir--;
+        frame_node[frame_id] = -1;
+        drop_node(n);
+        prune();
+    }
+};
+
+/**
+ * Full 2Q (Johnson & Shasha)
+ * First-time pages enter the FIFO A1in; pages evicted from A1in are remembered in the ghost queue A1out.
+ * A page faulted in again while on A1out goes to the LRU queue Am, so a page only reaches Am once it has
+ * proven to be reused, and a sequential scan only ever cycles through A1in.
+ * A1in is kept at about a quarter of the frames and A1out at half of them.
+ */
+class TwoQPager : public Pager {
+private:
+    enum { A1IN, AM };
+
+    FrameLists lists;
+    GhostList a1out;
+    int kin;            // target size of A1in
+    size_t kout;        // maximum size of A1out
+    bool pending_am;    // the page being faulted in was found on A1out
+
+public:
+    explicit TwoQPager(Simulator &sim) : Pager(sim), lists(2), kin(1), kout(1), pending_am(false) {}
+
+    void prepare() override {
+        lists.resize(sim.num_frames);
+        kin = max(1, sim.num_frames / 4);
+        kout = max(1, sim.num_frames / 2);
+    }
+
+    void note_fault(int pid, vpage_t vpage) override {
+        unsigned long long key = page_key(pid, vpage);
+        pending_am = a1out.contains(key);
+        if (pending_am)
+            a1out.remove(key);
+    }
+
+    frame_t *select_victim_frame() override {
+        int victim;
+        bool from_a1in = lists.size(A1IN) > kin || lists.size(AM) == 0;
+        if (from_a1in) {
+            victim = lists.back(A1IN);
+            a1out.push_front(page_key(sim.frame_table[victim].pid, sim.frame_table[victim].vpage));
+            if (a1out.size() > kout)
+                a1out.pop_back();
+        } else {
+            victim = lists.back(AM);
+        }
+        lists.remove(victim);
+
+        if (SHOW_AGING_INFO) printf("ASELECT %d %s\n", victim, from_a1in ? "A1in" : "Am");
+        return &sim.frame_table[victim];
+    }
+
+    void reset_age(unsigned int frame_id) override {
+        lists.remove((int) frame_id);
+        lists.push_front(pending_am ? AM : A1IN, (int) frame_id);
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        if (faulted) return;
+        // hits on A1in leave the FIFO order alone
+        if (lists.list_of((int) frame_id) == AM) {
+            lists.remove((int) frame_id);
+            lists.push_front(AM, (int) frame_id);
+        }
+    }
+
+    void release_frame(unsigned int frame_id) override {
+        lists.remove((int) frame_id);
+    }
+};
+
+/**
+ * Global variables part 2
+ */
+vector<ins_t> INSTRUCTIONS;            // list of instructions, empty in streaming mode
+const char *INPUT_FILE = nullptr;      // streaming mode: the trace, mapped again by every pass over it
+size_t SECTION_OFFSET = 0;             // streaming mode: file offset of the instruction section
+unsigned long long SECTION_RECORDS = 0; // streaming mode: instruction count of a binary trace
+int SECTION_VERSION = 0;               // streaming mode: format version of a binary trace
+
+/**
+ * Belady's optimal replacement, as a reference point for the other pagers
+ * A pass over INSTRUCTIONS records for every load/store the index of the next reference to the same
+ * (pid, vpage). The frames sit in an indexed max-heap keyed by the next use of their page, so the frame
+ * used furthest in the future is found and re-keyed in O(log n). Needs the preloaded trace (no -s).
+ */
+class OPTPager : public Pager {
+private:
+    static constexpr unsigned int NEVER = UINT_MAX; // the page is not referenced again
+
+    vector<unsigned int> next_use; // per instruction: index of the next reference to the same page
+    vector<int> heap;              // frame ids, the frame with the furthest next use on top
+    vector<int> heap_pos;          // position of each frame in the heap, -1 if not in it
+    vector<unsigned int> key;      // next use of the page in each frame
+
+    bool before(int a, int b) const {
+        return key[a] > key[b] || (key[a] == key[b] && a < b);
+    }
+
+    void swap_nodes(int i, int j) {
+        swap(heap[i], heap[j]);
+        heap_pos[heap[i]] = i;
+        heap_pos[heap[j]] = j;
+    }
+
+    void sift_up(int i) {
+        while (i > 0 && before(heap[i], heap[(i - 1) / 2])) {
+            swap_nodes(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(int i) {
+        int n = (int) heap.size();
+        while (true) {
+            int best = i;
+            int l = 2 * i + 1;
+            int r = l + 1;
+            if (l < n && before(heap[l], heap[best])) best = l;
+            if (r < n && before(heap[r], heap[best])) best = r;
+            if (best == i) return;
+            swap_nodes(i, best);
+            i = best;
+        }
+    }
+
+public:
+    using Pager::Pager;
+
+    void prepare() override {
+        if (STREAM_INSTRUCTIONS) {
+            printf("OPT pager needs the whole trace and cannot be used with -s\n");
+            exit(1);
+        }
+        if (INSTRUCTIONS.size() >= NEVER) {
+            printf("OPT pager supports at most %u instructions\n", NEVER - 1);
+            exit(1);
+        }
+
+        next_use.assign(INSTRUCTIONS.size(), NEVER);
+        unordered_map<unsigned long long, unsigned int> last_use;
+        int pid = 0;
+        for (unsigned int i = 0; i < INSTRUCTIONS.size(); i++) {
+            const ins_t &ins = INSTRUCTIONS[i];
+            if (ins.op == 'c') {
+                pid = (int) ins.addr;
+            } else if (ins.op == 'r' || ins.op == 'w') {
+                auto it = last_use.find(page_key(pid, ins.addr));
+                if (it == last_use.end()) {
+                    last_use.emplace(page_key(pid, ins.addr), i);
+                } else {
+                    next_use[it->second] = i;
+                    it->second = i;
+                }
+            }
+        }
+
+        heap.reserve(sim.num_frames);
+        heap_pos.assign(sim.num_frames, -1);
+        key.assign(sim.num_frames, NEVER);
+    }
+
+    frame_t *select_victim_frame() override {
+        int victim = heap[0];
+        if (SHOW_AGING_INFO) {
+            printf("ASELECT %d %lld\n", victim, key[victim] == NEVER ? -1LL : (long long) key[victim]);
+        }
+        return &sim.frame_table[victim];
+    }
+
+    void note_reference(unsigned int frame_id, bool faulted) override {
+        unsigned int old_key = key[frame_id];
+        key[frame_id] = next_use[sim.ins_counter - 1];
+
+        if (heap_pos[frame_id] == -1) {
+            heap_pos[frame_id] = (int) heap.size();
+            heap.push_back((int) frame_id);
+            sift_up(heap_pos[frame_id]);
+        } else if (key[frame_id] > old_key) {
+            sift_up(heap_pos[frame_id]);
+        } else {
+            sift_down(heap_pos[frame_id]);
+        }
+    }
+
+    void reset_age(unsigned int frame_id) override {}
+};
+
+/**
+ * Helper functions
+ */
+
+/**
+ * Initialize frames for the frame_table
+ */
+void Simulator::initialize_frames() {
+    frame_table.assign(num_frames, frame_t());
+    ref_bits.assign((num_frames + 63) / 64, 0);
+    mod_bits.assign((num_frames + 63) / 64, 0);
+    if (USE_INVERTED_PAGE_TABLE)
+        ipt = new InvertedPageTable(num_frames);
+    for (int i = 0; i < num_frames; i++) {
+        frame_t *frame = &frame_table[i];
+        frame->frame_id = i;
+
+        free_frames.push_back(frame);
+    }
+}
+
+/**
+ * Allocate frame from free list
+ * @return
+ */
+frame_t *Simulator::allocate_frame_from_free_list() {
+    if (free_frames.empty()) return nullptr;
+    frame_t *free_frame = free_frames.front();
+    free_frames.pop_front();
+    return free_frame;
+}
+
+/**
+ * Get a frame from the frame table
+ * @return frame to be associated with the virtual page
+ */
+frame_t *Simulator::get_frame() {
+    frame_t *frame = allocate_frame_from_free_list();
+    if (frame == nullptr)
+        frame = pager->select_victim_frame();
+    return frame;
+}
+
+/**
+ * @return int - the hand spread given after 't', -1 for the default, exits if it is not a non-negative number
+ */
+int parse_hand_spread(const char *args) {
+    if (*args == '\0')
+        return -1;
+    char *end = nullptr;
+    long spread = strtol(args, &end, 10);
+    if (end == args || *end != '\0' || spread < 0 || spread > INT_MAX) {
+        printf("invalid hand spread: %s\n", args);
+        exit(1);
+    }
+    return (int) spread;
+}
+
+/**
+ * Get the appropriate pager based on the arguments
+ * @param - args - string that needs to parsed to fetch the pager type
+ *
+ * @returns - the correct Pager based on the arguments
+ */
+Pager *getPager(const char *args, Simulator &sim) {
+    switch (args[0]) {
+        case 'f':
+            return new FCFSPager(sim);
+        case 'r':
+            return new RandomPager(sim);
+        case 'c':
+            return new ClockPager(sim);
+        case 't':
+            return new TwoHandClockPager(sim, parse_hand_spread(args + 1));
+        case 'e':
+            return new NRUPager(sim);
+        case 'a':
+            return new AgingPager(sim);
+        case 'w':
+            return new WorkingSetPager(sim);
+        case 'W':
+            return new WSClockPager(sim);
+        case 'F':
+            return new PFFPager(sim);
+        case 'l':
+            return new LRUPager(sim);
+        case 'o':
+            return new OPTPager(sim);
+        case 'A':
+            return new ARCPager(sim);
+        case 'P':
+            return new ClockProPager(sim);
+        case 'L':
+            return new LIRSPager(sim);
+        case '2':
+            return new TwoQPager(sim);
+        default:
+            printf("Unknown Replacement Algorithm: %c\n", args[0]);
+            exit(1);
+    }
+}
+
+/**
+ * Exit on an unknown pager before any input is read
+ */
+void check_pager(const char *args) {
+    Simulator probe;
+    delete getPager(args, probe);
+}
+
+/**
+ * Set up the processes of the loaded input, the frames and the pager
+ * @param - frames - number of frames
+ * @param - pager_args - the pager, as given with -a
+ */
+Simulator::Simulator(int frames, const char *pager_args) : Simulator() {
+    num_frames = frames;
+    for (int pid = 0; pid < NUM_PROCS; pid++)
+        procs.push_back(new Process(pid, PROC_VMAS[pid]));
+    pager = getPager(pager_args, *this);
+    initialize_frames();
+    pager->prepare();
+}
+
+Simulator::~Simulator() {
+    delete pager;
+    delete ipt;
+
+    for (Process *p: procs)
+        delete p;
+}
+
+/**
+ * Set the required output options from the arguments
+ * @param - args - string that needs to parsed to fetch all the options that need to be set
+ *
+ */
+void set_options(char *args) {
+    char *ch = args;
+
+    while (*ch != '\0') {
+        switch (*ch) {
+            case 'O':
+                VERBOSE = true;
+                break;
+            case 'P':
+                SHOW_PAGE_TABLE = true;
+                break;
+            case 'F':
+                SHOW_FRAME_TABLE = true;
+                break;
+            case 'S':
+                SHOW_STATS = true;
+                break;
+            case 'x':
+                SHOW_CURR_PT = true;
+                break;
+            case 'y':
+                SHOW_PROCESS_PT = true;
+                break;
+            case 'f':
+                SHOW_CURR_FT = true;
+                break;
+            case 'a':
+                SHOW_AGING_INFO = true;
+                break;
+            default:
+                printf("Unknown output option: <%c>\n", *ch);
+                exit(1);
+        }
+        ch++;
+    }
+}
+
+/**
+ * @return int - the frame count given in args, exits if it is not a number from 1 to MAX_FRAMES
+ */
+int parse_num_frames(const char *args) {
+    char *end = nullptr;
+    long count = strtol(args, &end, 10);
+    if (end == args || *end != '\0' || count < 1) {
+        printf("invalid number of frames: %s\n", args);
+        exit(1);
+    }
+    if (count > MAX_FRAMES) {
+        printf("sorry max frames supported = %d\n", MAX_FRAMES);
+        exit(1);
+    }
+    return (int) count;
+}
+
+/**
+ * Set the frame_table size from the arguments
+ * @param - args - string that needs to parsed to fetch the frame_table size
+ *
+ */
+void set_num_frames(char *args) {
+    NUM_FRAMES = parse_num_frames(args);
+}
+
+/**
+ * Set the number of threads used to parse a text trace and to run a sweep from the arguments
+ * @param - args - thread count, 0 uses one thread per available core
+ *
+ */
+void set_num_threads(char *args) {
+    char *end = nullptr;
+    long count = strtol(args, &end, 10);
+    if (end == args || *end != '\0' || count < 0 || count > INT_MAX) {
+        printf("invalid number of threads: %s\n", args);
+        exit(1);
+    }
+    if (count == 0)
+        count = max(1, (int) thread::hardware_concurrency());
+    NUM_THREADS = (int) count;
+}
+
+/**
+ * Set the miss-ratio curve mode from the arguments
+ * @param - args - 'e' for exact LRU stack distances, 's' for sampled (SHARDS) ones
+ *
+ */
+void set_mrc_mode(char *args) {
+    if (args[0] != 'e' && args[0] != 's') {
+        printf("Unknown MRC mode: %c\n", args[0]);
+        exit(1);
+    }
+    MRC_MODE = args[0];
+}
+
+/**
+ * Split a comma separated list
+ */
+vector<string> split_list(const string &list) {
+    vector<string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        if (end > start) items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+/**
+ * Set the sweep configurations from the arguments
+ * @param - args - "<pagers>:<frames>", both comma separated lists, e.g. "c,a,t8:16,32,64"
+ *
+ */
+void set_sweep(char *args) {
+    string spec = args;
+    size_t colon = spec.find(':');
+    if (colon == string::npos) {
+        printf("sweep needs <pagers>:<frames>\n");
+        exit(1);
+    }
+    SWEEP_PAGERS = split_list(spec.substr(0, colon));
+    SWEEP_FRAMES = split_list(spec.substr(colon + 1));
+    if (SWEEP_PAGERS.empty() || SWEEP_FRAMES.empty()) {
+        printf("sweep needs <pagers>:<frames>\n");
+        exit(1);
+    }
+    // fail on bad configurations before any of them runs
+    for (const string &pager: SWEEP_PAGERS)
+        check_pager(pager.c_str());
+    for (const string &frames: SWEEP_FRAMES)
+        parse_num_frames(frames.c_str());
+}
+
+/**
+ * Read command-line arguments and assign values to global variables
+ *
+ * @param - argc - total argument count
+ * @param - argv - array of arguments
+ */
+void read_arguments(int argc, char **argv) {
+    int option;
+    while ((option = getopt(argc, argv, "f:a:o:sC:j:iM:S:")) != -1) {
+        switch (option) {
+            case 'f':
+                set_num_frames(optarg);
+                break;
+            case 'a':
+                check_pager(optarg);
+                PAGER_ARGS = optarg;
+                break;
+            case 'o':
+                set_options(optarg);
+                break;
+            case 's':
+                STREAM_INSTRUCTIONS = true;
+                break;
+            case 'C':
+                CONVERT_OUTPUT = optarg;
+                break;
+            case 'j':
+                set_num_threads(optarg);
+                break;
+            case 'i':
+                USE_INVERTED_PAGE_TABLE = true;
+                break;
+            case 'M':
+                set_mrc_mode(optarg);
+                break;
+            case 'S':
+                set_sweep(optarg);
+                break;
+            default:
+                printf("option requires an argument -- %c\n", option);
+                printf("illegal option\n");
+                exit(1);
+        }
+    }
+
+    // OPTPager::prepare() would exit from a sweep thread while other configurations are running
+    if (STREAM_INSTRUCTIONS) {
+        for (const string &pager: SWEEP_PAGERS) {
+            if (pager[0] == 'o') {
+                printf("OPT pager needs the whole trace and cannot be used with -s\n");
+                exit(1);
+            }
+        }
+    }
+
+    if (argc == optind) {
+        printf("inputfile name not supplied\n");
+        exit(1);
+    }
+}
+
+/**
+ * Parse the numbers from the random-number file
+ *
+ * @param - filename - random-number file
+ */
+void parse_randoms(const char *filename) {
+    fstream rand_file;
+    rand_file.open(filename, ios::in);
+
+    if (!rand_file.is_open()) {
+        printf("Cannot open randomfile <%s>\n", filename);
+        exit(1);
+    }
+
+    string line;
+    getline(rand_file, line);
+    RAND_COUNT = stoi(line);
+
+    for (int i = 0; i < RAND_COUNT; i++) {
+        getline(rand_file, line);
+        RANDVALS.push_back(stoi(line));
+    }
+}
+
+/**
+ * Map the whole input file read-only into memory
+ *
+ * @param filename - input file
+ * @return mapped_file_t - the mapping (data is nullptr for an empty file)
+ */
+mapped_file_t map_input_file(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("Cannot open inputfile <%s>\n", filename);
+        exit(1);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0) {
+        printf("Cannot open inputfile <%s>\n", filename);
+        exit(1);
+    }
+
+    mapped_file_t file = {nullptr, (size_t) st.st_size};
+    if (file.size > 0) {
+        void *addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            printf("Cannot map inputfile <%s>\n", filename);
+            exit(1);
+        }
+        madvise(addr, file.size, MADV_SEQUENTIAL);
+        file.data = (const char *) addr;
+    }
+    close(fd);
+    return file;
+}
+
+/**
+ * Release a mapping obtained from map_input_file()
+ */
+void unmap_input_file(mapped_file_t &file) {
+    if (file.data != nullptr)
+        munmap((void *) file.data, file.size);
+    file.data = nullptr;
+    file.size = 0;
+}
+
+/**
+ * Move the cursor past the end of the current line
+ */
+inline void skip_line(const char *&cur, const char *end) {
+    const char *nl = (const char *) memchr(cur, '\n', end - cur);
+    cur = nl == nullptr ? end : nl + 1;
+}
+
+/**
+ * Move the cursor to the start of the next line holding data, skipping '#' comments and blank lines
+ *
+ * @return boolean - true if such a line exists, false at the end of the input
+ */
+inline bool next_data_line(const char *&cur, const char *end) {
+    while (cur < end) {
+        if (*cur == '#' || *cur == '\n' || *cur == '\r') {
+            skip_line(cur, end);
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Scan a (possibly signed) decimal integer, skipping leading blanks
+ * Behaves like atoi: stops at the first non-digit and yields 0 if there are no digits
+ */
+inline long long scan_int(const char *&cur, const char *end) {
+    while (cur < end && (*cur == ' ' || *cur == '\t'))
+        cur++;
+
+    bool negative = false;
+    if (cur < end && (*cur == '-' || *cur == '+')) {
+        negative = *cur == '-';
+        cur++;
+    }
+
+    long long value = 0;
+    while (cur < end && (unsigned) (*cur - '0') < 10) {
+        value = value * 10 + (*cur - '0');
+        cur++;
+    }
+    return negative ? -value : value;
+}
+
+/**
+ * Exit if a VMA bound does not fit the VPAGE_BITS wide vpages of vma_t
+ */
+void check_vma_bounds(long long start_page, long long end_page) {
+    if (start_page < 0 || start_page >= MAX_VPAGES || end_page < 0 || end_page >= MAX_VPAGES) {
+        printf("VMA %lld:%lld exceeds the %lld supported pages\n", start_page, end_page, MAX_VPAGES);
+        exit(1);
+    }
+}
+
+/**
+ * Parse the process and VMA header from the mapped input
+ *
+ * @param cur - cursor into the mapping, left at the start of the instruction section
+ * @param end - end of the mapping
+ */
+void parse_header(const char *&cur, const char *end) {
+    next_data_line(cur, end);
+    NUM_PROCS = (int) scan_int(cur, end);
+    skip_line(cur, end);
+
+    for (int i = 0; i < NUM_PROCS; i++) {
+        next_data_line(cur, end);
+        int num_vmas = (int) scan_int(cur, end);
+        skip_line(cur, end);
+
+        vector<vma_t> vmas;
+        for (int j = 0; j < num_vmas; j++) {
+            next_data_line(cur, end);
+
+            long long start_page = scan_int(cur, end);
+            long long end_page = scan_int(cur, end);
+            check_vma_bounds(start_page, end_page);
+
+            vma_t vma;
+            vma.start_page = start_page;
+            vma.end_page = end_page;
+            vma.is_write_protected = scan_int(cur, end);
+            vma.is_file_mapped = scan_int(cur, end);
+            skip_line(cur, end);
+
+            vmas.push_back(vma);
+        }
+        PROC_VMAS.push_back(vmas);
+    }
+}
+
+/**
+ * Parse one instruction line ("<op> <target>") and move the cursor to the next line
+ */
+inline ins_t parse_instruction(const char *&cur, const char *end) {
+    ins_t ins;
+    ins.op = *cur++;
+    ins.addr = scan_int(cur, end);
+    skip_line(cur, end);
+    return ins;
+}
+
+/**
+ * Binary trace format (.vmt), all integers are LEB128 varints unless noted otherwise
+ *
+ *   "VMT\0" <version>
+ *   <num_procs> { <num_vmas> { <start_page> <end_page> <flags: 1 = write protected, 2 = file mapped> } }
+ *   <instruction count: 8 byte little endian>
+ *   { <record> }
+ *
+ * Loads and stores carry the zigzag encoded difference to the page of the previous load or store. A record starts
+ * with a tag byte:
+ *
+ *   1 w dddddd   load (w = 0) or store (w = 1) whose difference d fits in 6 bits (-32 to 31)
+ *   0 11 nnnnn   the previous load or store, n + 1 more times
+ *   0 oo ppppp   opcode oo, followed by a varint v giving the payload (v << 5 | ppppp)
+ *
+ * Opcode 0 is 'r' and 1 is 'w' with the difference as payload, opcode 2 is 'c' or 'e' with the payload
+ * (process number << 1 | 1 for 'e'). Version 1 traces are still read; their records are a single varint
+ * (payload << 2 | opcode) with opcode 0 = 'r', 1 = 'w', 2 = 'c', 3 = 'e'.
+ *
+ * A trace that references the same or nearby pages in a row takes about a byte per run of references and is
+ * 10-20 times smaller than its text (a 40 MB 5M instruction trace converts to 2.0 MB, 5.1 MB as version 1). When
+ * consecutive pages are far apart every difference still needs its own 3-4 bytes of varint, which puts such
+ * traces at about 2.5 times smaller than text in either version: the text spends only 2-3 bytes more per line
+ * on a page number, and no per-record encoding gets below the entropy of the differences.
+ */
+const char VMT_OPCODES[] = {'r', 'w', 'c', 'e'};
+const unsigned char VMT_SHORT_TAG = 0x80; // tag bit of a one byte load/store
+const int VMT_SWITCH_OP = 2;              // long form opcode of 'c' and 'e'
+const int VMT_REPEAT_OP = 3;              // long form opcode of a repeat run
+const int VMT_MAX_REPEATS = 32;           // longest run a single repeat record holds
+
+/**
+ * Decode a varint, stopping at the end of the mapping
+ */
+inline unsigned long long read_varint(const char *&cur, const char *end) {
+    unsigned long long value = 0;
+    int shift = 0;
+    while (cur < end) {
+        auto byte = (unsigned char) *cur++;
+        value |= (unsigned long long) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return value;
+}
+
+/**
+ * Encode a varint into a buffer
+ *
+ * @return int - number of bytes written (at most 10)
+ */
+inline int write_varint(unsigned long long value, unsigned char *buffer) {
+    int len = 0;
+    while (value >= 0x80) {
+        buffer[len++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[len++] = (unsigned char) value;
+    return len;
+}
+
+inline unsigned long long zigzag_encode(long long value) {
+    return ((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63);
+}
+
+inline long long zigzag_decode(unsigned long long value) {
+    return (long long) (value >> 1) ^ -(long long) (value & 1);
+}
+
+/**
+ * Check whether a mapped file starts with the binary trace magic
+ */
+bool is_binary_trace(const mapped_file_t &file) {
+    return file.size >= sizeof(VMT_MAGIC) && memcmp(file.data, VMT_MAGIC, sizeof(VMT_MAGIC)) == 0;
+}
+
+/**
+ * Parse the process and VMA header of a binary trace
+ *
+ * @param reader - reader positioned after the magic, left at the first instruction record
+ */
+void parse_binary_header(trace_reader_t &reader) {
+    unsigned long long version = read_varint(reader.cur, reader.end);
+    if (version < 1 || version > VMT_VERSION) {
+        printf("Unsupported binary trace version %llu (expected 1 to %d)\n", version, VMT_VERSION);
+        exit(1);
+    }
+    reader.version = (int) version;
+
+    NUM_PROCS = (int) read_varint(reader.cur, reader.end);
+    for (int i = 0; i < NUM_PROCS; i++) {
+        int num_vmas = (int) read_varint(reader.cur, reader.end);
+
+        vector<vma_t> vmas;
+        for (int j = 0; j < num_vmas; j++) {
+            auto start_page = (long long) read_varint(reader.cur, reader.end);
+            auto end_page = (long long) read_varint(reader.cur, reader.end);
+            check_vma_bounds(start_page, end_page);
+
+            vma_t vma;
+            vma.start_page = start_page;
+            vma.end_page = end_page;
+            unsigned long long flags = read_varint(reader.cur, reader.end);
+            vma.is_write_protected = flags & 1;
+            vma.is_file_mapped = (flags >> 1) & 1;
+
+            vmas.push_back(vma);
+        }
+        PROC_VMAS.push_back(vmas);
+    }
+
+    if (reader.end - reader.cur < 8) {
+        printf("Truncated binary trace header\n");
+        exit(1);
+    }
+    reader.remaining = 0;
+    for (int i = 0; i < 8; i++)
+        reader.remaining |= (unsigned long long) (unsigned char) reader.cur[i] << (8 * i);
+    reader.cur += 8;
+}
+
+/**
+ * Parse the header of a mapped trace (text or binary) and return a reader for its instructions
+ */
+trace_reader_t open_trace(const mapped_file_t &file) {
+    trace_reader_t reader = {file.data, file.data + file.size, is_binary_trace(file), 0, 0, 0, 0, 0};
+    if (reader.is_binary) {
+        reader.cur += sizeof(VMT_MAGIC);
+        parse_binary_header(reader);
+    } else {
+        parse_header(reader.cur, reader.end);
+    }
+    return reader;
+}
+
+/**
+ * Read the next instruction from a trace
+ *
+ * @return boolean - true if an instruction was read, false at the end of the trace
+ */
+inline bool read_instruction(trace_reader_t &reader, ins_t &ins) {
+    if (!reader.is_binary) {
+        if (!next_data_line(reader.cur, reader.end))
+            return false;
+        ins = parse_instruction(reader.cur, reader.end);
+        return true;
+    }
+
+    if (reader.remaining == 0)
+        return false;
+    if (reader.repeats > 0) {
+        reader.repeats--;
+        reader.remaining--;
+        ins.op = reader.prev_op;
+        ins.addr = reader.prev_vpage;
+        return true;
+    }
+    if (reader.cur >= reader.end)
+        return false;
+    reader.remaining--;
+
+    unsigned long long payload;
+    if (reader.version == 1) {
+        unsigned long long record = read_varint(reader.cur, reader.end);
+        ins.op = VMT_OPCODES[record & 3];
+        payload = record >> 2;
+    } else {
+        auto tag = (unsigned char) *reader.cur++;
+        if (tag & VMT_SHORT_TAG) {
+            ins.op = (tag & 0x40) ? 'w' : 'r';
+            payload = tag & 0x3f;
+        } else if (tag >> 5 == VMT_REPEAT_OP) {
+            reader.repeats = tag & 0x1f;
+            ins.op = reader.prev_op;
+            ins.addr = reader.prev_vpage;
+            return true;
+        } else {
+            payload = read_varint(reader.cur, reader.end) << 5 | (tag & 0x1f);
+            if (tag >> 5 == VMT_SWITCH_OP) {
+                ins.op = (payload & 1) ? 'e' : 'c';
+                payload >>= 1;
+            } else {
+                ins.op = VMT_OPCODES[tag >> 5];
+            }
+        }
+    }
+
+    if (ins.op == 'r' || ins.op == 'w') {
+        reader.prev_vpage += zigzag_decode(payload);
+        reader.prev_op = ins.op;
+        ins.addr = reader.prev_vpage;
+    } else {
+        ins.addr = (long long) payload;
+    }
+    return true;
+}
+
+/**
+ * Encode a record of the long form (tag byte and varint) into a buffer
+ *
+ * @return int - number of bytes written (at most 11)
+ */
+inline int write_long_record(int opcode, unsigned long long payload, unsigned char *buffer) {
+    buffer[0] = (unsigned char) (opcode << 5 | (payload & 0x1f));
+    return 1 + write_varint(payload >> 5, buffer + 1);
 }
 
 /**
- * Set the frame_table size from the arguments
- * @param - args - string that needs to parsed to fetch the frame_table size
+ * Convert a trace (text or binary) into the binary format
+ * Instructions are converted one at a time, so this runs in constant memory
  *
+ * @param filename - input trace
+ * @param outname - binary trace to write
  */
-void set_num_frames(char *args) {
-    int count = atoi(args);
-    if (count > MAX_FRAMES) {
-        printf("sorry max frames supported = %d\n", MAX_FRAMES);
+void convert_trace(const char *filename, const char *outname) {
+    mapped_file_t file = map_input_file(filename);
+    trace_reader_t reader = open_trace(file);
+
+    FILE *out = fopen(outname, "wb");
+    if (out == nullptr) {
+        printf("Cannot open outputfile <%s>\n", outname);
         exit(1);
     }
-    NUM_FRAMES = count;
-}
 
-/**
- * Read command-line arguments and assign values to global variables
- *
- * @param - argc - total argument count
- * @param - argv - array of arguments
- */
-void read_arguments(int argc, char **argv) {
-    int option;
-    while ((option = getopt(argc, argv, "f:a:o:")) != -1) {
-        switch (option) {
-            case 'f':
-                set_num_frames(optarg);
-                break;
-            case 'a':
-                PAGER = getPager(optarg);
+    unsigned char buffer[16];
+    fwrite(VMT_MAGIC, 1, sizeof(VMT_MAGIC), out);
+    fwrite(buffer, 1, write_varint(VMT_VERSION, buffer), out);
+    fwrite(buffer, 1, write_varint(NUM_PROCS, buffer), out);
+    for (const vector<vma_t> &vmas: PROC_VMAS) {
+        fwrite(buffer, 1, write_varint(vmas.size(), buffer), out);
+        for (vma_t vma: vmas) {
+            fwrite(buffer, 1, write_varint(vma.start_page, buffer), out);
+            fwrite(buffer, 1, write_varint(vma.end_page, buffer), out);
+            fwrite(buffer, 1, write_varint(vma.is_write_protected | vma.is_file_mapped << 1, buffer), out);
+        }
+    }
+
+    // the instruction count is patched in once all records are written
+    long count_offset = ftell(out);
+    memset(buffer, 0, 8);
+    fwrite(buffer, 1, 8, out);
+
+    unsigned long long count = 0;
+    long long prev_vpage = 0;
+    char prev_op = 0;
+    int repeats = 0; // identical loads/stores after the last written one, not yet written
+    auto write_repeats = [&]() {
+        if (repeats == 0) return;
+        buffer[0] = (unsigned char) (VMT_REPEAT_OP << 5 | (repeats - 1));
+        fwrite(buffer, 1, 1, out);
+        repeats = 0;
+    };
+    ins_t ins;
+    while (read_instruction(reader, ins)) {
+        count++;
+        if (ins.op == prev_op && ins.addr == prev_vpage) {
+            if (++repeats == VMT_MAX_REPEATS)
+                write_repeats();
+            continue;
+        }
+        write_repeats();
+
+        int len;
+        switch (ins.op) {
+            case 'r':
+            case 'w': {
+                unsigned long long delta = zigzag_encode(ins.addr - prev_vpage);
+                if (delta < 0x40) {
+                    buffer[0] = (unsigned char) (VMT_SHORT_TAG | (ins.op == 'w') << 6 | delta);
+                    len = 1;
+                } else {
+                    len = write_long_record(ins.op == 'r' ? 0 : 1, delta, buffer);
+                }
+                prev_vpage = ins.addr;
+                prev_op = ins.op;
                 break;
-            case 'o':
-                set_options(optarg);
+            }
+            case 'c':
+            case 'e':
+                len = write_long_record(VMT_SWITCH_OP, (unsigned long long) ins.addr << 1 | (ins.op == 'e'), buffer);
                 break;
             default:
-                printf("option requires an argument -- %c\n", option);
-                printf("illegal option\n");
+                printf("Incorrect instruction operation <%c>\n", ins.op);
                 exit(1);
         }
+        fwrite(buffer, 1, len, out);
     }
+    write_repeats();
 
-    if (argc == optind) {
-        printf("inputfile name not supplied\n");
-        exit(1);
-    }
+    for (int i = 0; i < 8; i++)
+        buffer[i] = (unsigned char) (count >> (8 * i));
+    fseek(out, count_offset, SEEK_SET);
+    fwrite(buffer, 1, 8, out);
+
+    fclose(out);
+    unmap_input_file(file);
 }
 
 /**
- * Parse the numbers from the random-number file
- *
- * @param - filename - random-number file
+ * Bounded-memory instruction source used in streaming mode (-s)
+ * Instructions are parsed into one of two fixed-size buffers while the simulation consumes the other one.
+ * Parts of the mapping that have been parsed are dropped again, so memory use does not depend on the trace length.
  */
-void parse_randoms(const char *filename) {
-    fstream rand_file;
-    rand_file.open(filename, ios::in);
+class InstructionStream {
+private:
+    mapped_file_t file;
+    trace_reader_t reader;        // only touched by the refill thread while it runs
+    const char *released;         // mapping before this point has been handed back to the kernel
+    vector<ins_t> buffers[2];
+    int active;                   // buffer currently consumed by the simulation
+    size_t pos;                   // next instruction in the active buffer
+    thread refill_thread;
+
+    void fill(vector<ins_t> &buffer) {
+        buffer.clear();
+        ins_t ins;
+        while (buffer.size() < STREAM_BUFFER_SIZE && read_instruction(reader, ins))
+            buffer.push_back(ins);
+        release_parsed_pages();
+    }
 
-    if (!rand_file.is_open()) {
-        printf("Cannot open randomfile <%s>\n", filename);
-        exit(1);
+    void release_parsed_pages() {
+        long page_size = sysconf(_SC_PAGESIZE);
+        const char *boundary = file.data + ((reader.cur - file.data) / page_size) * page_size;
+        if (boundary > released) {
+            madvise((void *) released, boundary - released, MADV_DONTNEED);
+            released = boundary;
+        }
     }
 
-    string line;
-    getline(rand_file, line);
-    RAND_COUNT = stoi(line);
+    void start_refill() {
+        refill_thread = thread([this] { fill(buffers[1 - active]); });
+    }
 
-    for (int i = 0; i < RAND_COUNT; i++) {
-        getline(rand_file, line);
-        RANDVALS.push_back(stoi(line));
+public:
+    InstructionStream(mapped_file_t mapping, trace_reader_t trace) : file(mapping), reader(trace),
+                                                                      released(mapping.data), active(0), pos(0) {
+        buffers[0].reserve(STREAM_BUFFER_SIZE);
+        buffers[1].reserve(STREAM_BUFFER_SIZE);
+        start_refill();
     }
-}
+
+    ~InstructionStream() {
+        if (refill_thread.joinable())
+            refill_thread.join();
+        unmap_input_file(file);
+    }
+
+    bool next(ins_t &ins) {
+        if (pos == buffers[active].size()) {
+            refill_thread.join();
+            active = 1 - active;
+            pos = 0;
+            if (buffers[active].empty())
+                return false;
+            start_refill();
+        }
+        ins = buffers[active][pos++];
+        return true;
+    }
+};
 
 /**
- * Parse the input file to initialize the program
+ * Parse the instruction section of a text trace with several threads
+ * The section is split into newline-aligned chunks, each parsed into its own buffer,
+ * and the buffers are then copied into INSTRUCTIONS in order.
  *
- * @param string
+ * @param reader - text reader positioned at the start of the instruction section
+ * @param num_threads - maximum number of parser threads
  */
-void load_input(const char *filename) {
-    fstream input_file;
-
-    input_file.open(filename, ios::in);
+void load_instructions_parallel(const trace_reader_t &reader, int num_threads) {
+    size_t section_size = reader.end - reader.cur;
+    size_t num_chunks = min((size_t) num_threads, max((size_t) 1, section_size / PARSE_CHUNK_MIN_SIZE));
+
+    vector<const char *> bounds(num_chunks + 1);
+    bounds[0] = reader.cur;
+    bounds[num_chunks] = reader.end;
+    for (size_t i = 1; i < num_chunks; i++) {
+        const char *split = reader.cur + section_size / num_chunks * i;
+        if (split < bounds[i - 1])
+            split = bounds[i - 1];
+        else if (split > reader.cur && split[-1] != '\n')
+            skip_line(split, reader.end);
+        bounds[i] = split;
+    }
 
-    if (!input_file.is_open()) {
-        printf("Cannot open inputfile <%s>\n", filename);
-        exit(1);
+    vector<vector<ins_t>> chunks(num_chunks);
+    vector<thread> workers;
+    for (size_t i = 0; i < num_chunks; i++) {
+        workers.emplace_back([&, i] {
+            trace_reader_t chunk_reader = reader;
+            chunk_reader.cur = bounds[i];
+            chunk_reader.end = bounds[i + 1];
+            chunks[i].reserve((chunk_reader.end - chunk_reader.cur) / 4);
+
+            ins_t ins;
+            while (read_instruction(chunk_reader, ins))
+                chunks[i].push_back(ins);
+        });
+    }
+    for (thread &worker: workers)
+        worker.join();
+
+    vector<size_t> offsets(num_chunks + 1, 0);
+    for (size_t i = 0; i < num_chunks; i++)
+        offsets[i + 1] = offsets[i] + chunks[i].size();
+    INSTRUCTIONS.resize(offsets[num_chunks]);
+
+    workers.clear();
+    for (size_t i = 0; i < num_chunks; i++) {
+        workers.emplace_back([&, i] {
+            copy(chunks[i].begin(), chunks[i].end(), INSTRUCTIONS.begin() + (long) offsets[i]);
+            vector<ins_t>().swap(chunks[i]);
+        });
     }
+    for (thread &worker: workers)
+        worker.join();
+}
 
-    string line;
+/**
+ * Parse the input file (text or binary trace) to initialize the program
+ * The file is memory-mapped and parsed in place, without any per-line copies
+ *
+ * @param filename - input file
+ */
+void load_input(const char *filename) {
+    mapped_file_t file = map_input_file(filename);
 
     /**
      * Load Process Information
      */
-    getline(input_file, line);
-    while (line[0] == '#')
-        getline(input_file, line);
+    trace_reader_t reader = open_trace(file);
 
-    NUM_PROCS = atoi(line.c_str());
+    /**
+     * Load Instructions
+     */
+    if (STREAM_INSTRUCTIONS) {
+        // every pass maps the trace again and streams the instructions from here
+        INPUT_FILE = filename;
+        SECTION_OFFSET = reader.cur - file.data;
+        SECTION_RECORDS = reader.remaining;
+        SECTION_VERSION = reader.version;
+        unmap_input_file(file);
+        return;
+    }
 
-    for (int i = 0; i < NUM_PROCS; i++) {
-        getline(input_file, line);
-        while (line[0] == '#')
-            getline(input_file, line);
-        auto *process = new Process();
-        process->num_vmas = atoi(line.c_str());
+    if (!reader.is_binary && NUM_THREADS > 1) {
+        load_instructions_parallel(reader, NUM_THREADS);
+        unmap_input_file(file);
+        return;
+    }
 
-        for (int j = 0; j < process->num_vmas; j++) {
-            getline(input_file, line);
-            while (line[0] == '#')
-                getline(input_file, line);
+    if (reader.is_binary)
+        INSTRUCTIONS.reserve(reader.remaining);
+    else
+        INSTRUCTIONS.reserve((reader.end - reader.cur) / 4); // every instruction line takes at least 4 bytes ("r 0\n")
 
-            vma_t vma;
-            int sp, ep, wp, fm;
-            char *buffer = new char[line.length() + 1];
-            strcpy(buffer, line.c_str());
-            sscanf(buffer, "%d %d %d %d", &sp, &ep, &wp, &fm);
-            vma.start_page = sp;
-            vma.end_page = ep;
-            vma.is_write_protected = wp;
-            vma.is_file_mapped = fm;
+    ins_t ins;
+    while (read_instruction(reader, ins))
+        INSTRUCTIONS.push_back(ins);
 
-            process->vma_list.push_back(vma);
+    unmap_input_file(file);
+}
 
-            delete[] buffer;
-        }
-        PROCS.push_back(process);
+/**
+ * One pass over the instructions of the loaded trace
+ * A preloaded trace is shared and only indexed; in streaming mode every cursor maps the trace again and
+ * parses it through an InstructionStream of its own, so passes can run side by side in bounded memory.
+ */
+class InstructionCursor {
+private:
+    size_t next_ins;               // index of the next preloaded instruction
+    InstructionStream *stream;     // streaming mode only, nullptr when the trace is preloaded
+
+public:
+    InstructionCursor() : next_ins(0), stream(nullptr) {
+        if (!STREAM_INSTRUCTIONS) return;
+        mapped_file_t file = map_input_file(INPUT_FILE);
+        trace_reader_t reader = {file.data + SECTION_OFFSET, file.data + file.size, is_binary_trace(file),
+                                 SECTION_RECORDS, 0, SECTION_VERSION, 0, 0};
+        stream = new InstructionStream(file, reader);
     }
 
-    /**
-     * Load Instructions
-     */
-    while (getline(input_file, line)) {
-        if (line[0] == '#')
-            continue;
+    InstructionCursor(const InstructionCursor &) = delete;
 
-        char *buffer = new char[line.length() + 1];
-        strcpy(buffer, line.c_str());
+    InstructionCursor &operator=(const InstructionCursor &) = delete;
 
-        ins_t ins;
-        sscanf(buffer, "%c %d", &ins.op, &ins.addr);
-        INSTRUCTIONS.push_back(ins);
+    ~InstructionCursor() {
+        delete stream;
+    }
 
-        delete[] buffer;
+    /**
+     * Fetch the next instruction
+     *
+     * @param opcode - any one of 'c', 'r', 'w', 'e'
+     * @param target - virtual page number or process number
+     *
+     * @return boolean - true if next instruction is present, false if not
+     */
+    bool next(char &opcode, long long &target) {
+        ins_t instruction;
+        if (stream != nullptr) {
+            if (!stream->next(instruction))
+                return false;
+        } else {
+            if (next_ins == INSTRUCTIONS.size())
+                return false;
+            instruction = INSTRUCTIONS[next_ins++];
+        }
+        opcode = instruction.op;
+        target = instruction.addr;
+        return true;
     }
-}
+};
 
 /**
- * Fetch the next instruction
- *
- * @param opcode - any one of 'c', 'r', 'w', 'e'
- * @param target - virtual page number or process number
- *
- * @return boolean - true if next instruction is present, false if not
+ * Handle context switch operation
+ * @param target - process number
  */
-bool get_next_instruction(char &opcode, int &target) {
-    if (INSTRUCTIONS.empty())
-        return false;
-    ins_t instruction = INSTRUCTIONS.front();
-    opcode = instruction.op;
-    target = instruction.addr;
-    INSTRUCTIONS.pop_front();
-    return true;
+void Simulator::handle_context_switch(long long target) {
+    curr_proc = procs[target];
+
+    ctx_switches++;
+    cost += CTX_SWITCH_TIME;
 }
 
 /**
- * Handle context switch operation
- * @param target - process number
+ * Find the page table entry of a vpage of a process, without materializing it
+ *
+ * @return pte_t* - the entry, nullptr if the vpage has none (with -i: if the page is not resident)
  */
-void handle_context_switch(int target) {
-    CURR_PROC = PROCS[target];
-
-    CTX_SWITCHES++;
-    COST += CTX_SWITCH_TIME;
+pte_t *Simulator::find_pte(Process *proc, vpage_t vpage) {
+    if (vpage < 0 || vpage >= MAX_VPAGES)
+        return nullptr;
+    if (ipt != nullptr)
+        return ipt->find(proc->get_pid(), vpage);
+    return proc->page_table.find(vpage);
 }
 
 /**
  * Checks if the vpage is valid (present in one of the VMAs)
- * Caches the corresponding VMA values to the page table entry
+ * Caches the corresponding VMA values to the page table entry, which is only materialized for valid vpages
+ * With the inverted page table the entry is a staged one that install() later moves into its frame
  *
  * @param vpage - virtual page number
- * @return boolean - true if it is valid, false if not
+ * @return pte_t* - the page table entry if the vpage is valid, nullptr if not
  */
-bool check_validity_and_cache_details(int vpage) {
-    pte_t *pte = &(CURR_PROC->page_table[vpage]);
-    if (pte->is_assigned_to_vma)
-        return true;
-
-    for (int i = 0; i < CURR_PROC->num_vmas; i++) {
-        vma_t vma = CURR_PROC->vma_list[i];
-        if (vpage >= vma.start_page && vpage <= vma.end_page) {
+pte_t *Simulator::check_validity_and_cache_details(vpage_t vpage) {
+    pte_t *pte = ipt != nullptr ? nullptr : curr_proc->page_table.find(vpage);
+    if (pte != nullptr && pte->is_assigned_to_vma)
+        return pte;
+
+    for (int i = 0; i < curr_proc->num_vmas; i++) {
+        vma_t vma = curr_proc->vma_list[i];
+        if (vpage >= (vpage_t) vma.start_page && vpage <= (vpage_t) vma.end_page) {
+            if (ipt != nullptr)
+                pte = ipt->stage(curr_proc->get_pid(), vpage);
+            else
+                pte = curr_proc->page_table.walk(vpage);
             pte->is_assigned_to_vma = true;
             pte->is_write_protected = vma.is_write_protected;
             pte->is_file_mapped = vma.is_file_mapped;
-            return true;
+            return pte;
         }
     }
 
-    return false;
+    return nullptr;
 }
 
 /**
  * Unmap the victim frame from its previous vpage association
  */
-void unmap_victim_frame(frame_t *victim) {
-    int old_vpage = victim->vpage;
+void Simulator::unmap_victim_frame(frame_t *victim) {
+    vpage_t old_vpage = victim->vpage;
     int old_pid = victim->pid;
 
-    pte_t *old_pte = &(PROCS[old_pid]->page_table[old_vpage]);
+    pte_t *old_pte = victim->pte;
 
     old_pte->is_present = false;
 
-    if (VERBOSE) printf(" UNMAP %d:%d\n", old_pid, old_vpage);
-    PROCS[old_pid]->unmaps++;
-    COST += UNMAPS_TIME;
+    if (VERBOSE) printf(" UNMAP %d:%lld\n", old_pid, old_vpage);
+    procs[old_pid]->unmaps++;
+    cost += UNMAPS_TIME;
 
-    if (old_pte->is_modified) {
+    if (is_frame_modified(victim->frame_id)) {
         if (old_pte->is_file_mapped) {
             if (VERBOSE) printf(" FOUT\n");
-            PROCS[old_pid]->fouts++;
-            COST += FOUTS_TIME;
+            procs[old_pid]->fouts++;
+            cost += FOUTS_TIME;
         } else {
             old_pte->is_paged_out = true;
             if (VERBOSE)printf(" OUT\n");
-            PROCS[old_pid]->outs++;
-            COST += OUTS_TIME;
+            procs[old_pid]->outs++;
+            cost += OUTS_TIME;
         }
-        old_pte->is_modified = false;
+        clear_frame_modified(victim->frame_id);
     }
 
     old_pte->is_present = false;
+
+    if (ipt != nullptr)
+        ipt->evict(victim);
 }
 
 /**
@@ -740,22 +3583,24 @@ void unmap_victim_frame(frame_t *victim) {
  * @param op
  * @param vpage
  */
-void handle_load_store(char op, int vpage) {
+void Simulator::handle_load_store(char op, vpage_t vpage) {
 
-    COST += LD_ST_TIME;
+    cost += LD_ST_TIME;
 
-    pte_t *pte = &(CURR_PROC->page_table[vpage]);
-    if (!pte->is_present) {
-        bool is_valid = check_validity_and_cache_details(vpage);
-        if (!is_valid) {
+    pte_t *pte = find_pte(curr_proc, vpage);
+    bool faulted = pte == nullptr || !pte->is_present;
+    if (faulted) {
+        pte = check_validity_and_cache_details(vpage);
+        if (pte == nullptr) {
             if (VERBOSE)
                 printf(" SEGV\n");
 
-            CURR_PROC->segv++;
-            COST += SEGV_TIME;
+            curr_proc->segv++;
+            cost += SEGV_TIME;
             return;
         }
 
+        pager->note_fault(curr_proc->get_pid(), vpage);
         frame_t *new_frame = get_frame();
 
         if (new_frame->is_victim) {
@@ -764,23 +3609,27 @@ void handle_load_store(char op, int vpage) {
 
         if (pte->is_file_mapped) {
             if (VERBOSE) printf(" FIN\n");
-            CURR_PROC->fins++;
-            COST += FINS_TIME;
+            curr_proc->fins++;
+            cost += FINS_TIME;
         } else if (pte->is_paged_out) {
             if (VERBOSE) printf(" IN\n");
-            CURR_PROC->ins++;
-            COST += INS_TIME;
+            curr_proc->ins++;
+            cost += INS_TIME;
         } else {
             if (VERBOSE) printf(" ZERO\n");
-            CURR_PROC->zeros++;
-            COST += ZEROS_TIME;
+            curr_proc->zeros++;
+            cost += ZEROS_TIME;
         }
 
+        if (ipt != nullptr)
+            pte = ipt->install(curr_proc->get_pid(), vpage, new_frame->frame_id);
+
         // assign new pte details to new frame
         new_frame->is_victim = true;
-        new_frame->pid = CURR_PROC->get_pid();
+        new_frame->pid = curr_proc->get_pid();
         new_frame->vpage = vpage;
         new_frame->is_assigned = true;
+        new_frame->pte = pte;
 
 
         // assign new frame details to new pte
@@ -788,77 +3637,106 @@ void handle_load_store(char op, int vpage) {
         pte->frame_num = new_frame->frame_id;
 
         if (VERBOSE) printf(" MAP %d\n", pte->frame_num);
-        CURR_PROC->maps++;
-        COST += MAPS_TIME;
-        PAGER->reset_age(pte->frame_num);
+        curr_proc->maps++;
+        cost += MAPS_TIME;
+        pager->reset_age(pte->frame_num);
     }
 
-    pte->is_referenced = 1;
+    set_frame_referenced(pte->frame_num);
+    pager->note_reference(pte->frame_num, faulted);
 
     if (op == 'w') {
         if (pte->is_write_protected) {
             if (VERBOSE) printf(" SEGPROT\n");
-            CURR_PROC->segprot++;
-            COST += SEGPROT_TIME;
+            curr_proc->segprot++;
+            cost += SEGPROT_TIME;
         } else {
-            pte->is_modified = 1;
+            set_frame_modified(pte->frame_num);
         }
     }
 }
 
+/**
+ * Unmap and free a frame of an exiting process
+ */
+void Simulator::release_exited_frame(frame_t *frame) {
+    pte_t *pte = frame->pte;
+    int pid = frame->pid;
+    vpage_t vpage = frame->vpage;
+
+    // unmap this frame
+    if (VERBOSE) printf(" UNMAP %d:%lld\n", pid, vpage);
+    procs[pid]->unmaps++;
+    cost += UNMAPS_TIME;
+
+    // clear out the page table entry as well
+    if (is_frame_modified(frame->frame_id) && pte->is_file_mapped) {
+        if (VERBOSE) printf(" FOUT\n");
+        procs[pid]->fouts++;
+        cost += FOUTS_TIME;
+    }
+    pte->is_paged_out = false;
+    clear_frame_referenced(frame->frame_id);
+    clear_frame_modified(frame->frame_id);
+    if (ipt != nullptr)
+        ipt->evict(frame);
+    pager->release_frame(frame->frame_id);
+
+    // free the frame
+    frame->is_assigned = false;
+    frame->pid = -1;
+    frame->vpage = -1;
+    frame->is_victim = false;
+    frame->pte = nullptr;
+
+    free_frames.push_back(frame);
+}
+
 /**
  * Handle Process Exit Operations
  * @param target - process number
  */
-void handle_process_exit(int target) {
-    printf("EXIT current process %d\n", target);
-    PROC_EXITS++;
-    COST += PROC_EXIT_TIME;
-
-    Process *active_process = PROCS[target];
-
-    for (int i = 0; i < MAX_VPAGES; i++) {
-        pte_t *pte = &(active_process->page_table[i]);
-        if (pte->is_present) {
-            frame_t *frame = &FRAME_TABLE[pte->frame_num];
-            int pid = frame->pid;
-            int vpage = frame->vpage;
-
-            // unmap this frame
-            if (VERBOSE) printf(" UNMAP %d:%d\n", pid, vpage);
-            PROCS[pid]->unmaps++;
-            COST += UNMAPS_TIME;
-
-            // free the frame
-            frame->is_assigned = false;
-            frame->pid = -1;
-            frame->vpage = -1;
-            frame->is_victim = false;
-
-            FREE_FRAMES.push_back(frame);
-
-            // clear out the page table entry as well
-            if (pte->is_modified && pte->is_file_mapped) {
-                if (VERBOSE) printf(" FOUT\n");
-                PROCS[pid]->fouts++;
-                COST += FOUTS_TIME;
-            }
-        }
-        pte->is_present = pte->is_referenced = pte->is_paged_out = 0;
+void Simulator::handle_process_exit(long long target) {
+    if (!quiet) printf("EXIT current process %lld\n", target);
+    proc_exits++;
+    cost += PROC_EXIT_TIME;
+
+    Process *active_process = procs[target];
+
+    if (ipt != nullptr) {
+        // the frames of the process are released in vpage order, like a page table walk would
+        vector<frame_t *> frames;
+        for (frame_t &frame: frame_table)
+            if (frame.is_assigned && frame.pid == target)
+                frames.push_back(&frame);
+        sort(frames.begin(), frames.end(), [](frame_t *a, frame_t *b) { return a->vpage < b->vpage; });
+        for (frame_t *frame: frames)
+            release_exited_frame(frame);
+        ipt->release_swap((int) target);
+        return;
     }
+
+    active_process->page_table.for_each([this](vpage_t, pte_t *pte) {
+        if (pte->is_present)
+            release_exited_frame(&frame_table[pte->frame_num]);
+    });
+
+    // nothing of the address space survives the exit, so the whole tree can go
+    active_process->page_table.clear();
 }
 
 /**
  * Start simulation
  */
-void run_simulation() {
+void Simulator::run_simulation() {
+    InstructionCursor instructions;
     char op = 0;
-    int target = 0;
-    while (get_next_instruction(op, target)) {
+    long long target = 0;
+    while (instructions.next(op, target)) {
         if (VERBOSE) {
-            printf("%d: ==> %c %d\n", INS_COUNTER, op, target);
+            printf("%llu: ==> %c %lld\n", ins_counter, op, target);
         }
-        INS_COUNTER++;
+        ins_counter++;
         switch (op) {
             case 'c':
                 handle_context_switch(target);
@@ -877,43 +3755,345 @@ void run_simulation() {
     }
 }
 
+/**
+ * LRU stack distances (Mattson) over page_key()s
+ * A Fenwick tree over access times holds a 1 at the last access time of every page, so the stack distance of
+ * a reference is one plus the number of pages accessed after the page's previous access. When the times run
+ * out the live pages are renumbered in access order, keeping the tree proportional to the number of pages.
+ */
+class StackDistances {
+private:
+    vector<int> tree;                                            // Fenwick tree over times 1..tree.size() - 1
+    unordered_map<unsigned long long, unsigned long long> last_access; // page -> time of its last access
+    unsigned long long now;
+
+    void add(unsigned long long t, int delta) {
+        for (; t < tree.size(); t += t & -t)
+            tree[t] += delta;
+    }
+
+    unsigned long long accessed_up_to(unsigned long long t) const {
+        unsigned long long count = 0;
+        for (; t > 0; t -= t & -t)
+            count += tree[t];
+        return count;
+    }
+
+    void compact() {
+        vector<pair<unsigned long long, unsigned long long>> pages; // (time, page)
+        pages.reserve(last_access.size());
+        for (auto &entry: last_access)
+            pages.emplace_back(entry.second, entry.first);
+        sort(pages.begin(), pages.end());
+
+        tree.assign(max((size_t) 1024, 2 * pages.size()) + 1, 0);
+        now = 0;
+        for (auto &page: pages) {
+            last_access[page.second] = ++now;
+            add(now, 1);
+        }
+    }
+
+public:
+    StackDistances() : now(0) {
+        tree.assign(1025, 0);
+    }
+
+    /**
+     * Record an access to a page
+     * @return unsigned long long - its stack distance (1 for the most recently used page), 0 on a first access
+     */
+    unsigned long long access(unsigned long long key) {
+        if (now + 1 == tree.size())
+            compact();
+        now++;
+
+        unsigned long long distance = 0;
+        auto it = last_access.find(key);
+        if (it == last_access.end()) {
+            last_access.emplace(key, now);
+        } else {
+            distance = last_access.size() - accessed_up_to(it->second) + 1;
+            add(it->second, -1);
+            it->second = now;
+        }
+        add(now, 1);
+        return distance;
+    }
+
+    /**
+     * Drop a page from the stack
+     */
+    void remove(unsigned long long key) {
+        auto it = last_access.find(key);
+        if (it == last_access.end()) return;
+        add(it->second, -1);
+        last_access.erase(it);
+    }
+
+    /**
+     * Drop every page of an exited process from the stack
+     */
+    void remove_process(int pid) {
+        for (auto it = last_access.begin(); it != last_access.end();) {
+            if ((int) (it->first >> VPAGE_BITS) == pid) {
+                add(it->second, -1);
+                it = last_access.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+/**
+ * @return bool - whether the vpage lies in one of the VMAs of the process
+ */
+bool is_valid_vpage(const vector<vma_t> &vmas, vpage_t vpage) {
+    for (const vma_t &vma: vmas)
+        if (vpage >= (vpage_t) vma.start_page && vpage <= (vpage_t) vma.end_page)
+            return true;
+    return false;
+}
+
+/**
+ * Run over the instructions without simulating, calling on_reference(pid, vpage) for every load/store to a
+ * valid vpage and on_exit(pid) for every process exit
+ */
+template<typename OnReference, typename OnExit>
+void for_each_reference(OnReference on_reference, OnExit on_exit) {
+    int pid = -1;
+    InstructionCursor instructions;
+    char op = 0;
+    long long target = 0;
+    while (instructions.next(op, target)) {
+        switch (op) {
+            case 'c':
+                pid = (int) target;
+                break;
+            case 'e':
+                on_exit((int) target);
+                break;
+            case 'r':
+            case 'w':
+                if (is_valid_vpage(PROC_VMAS[pid], target))
+                    on_reference(pid, target);
+                break;
+            default:
+                printf("Incorrect instruction operation <%c>\n", op);
+                exit(1);
+        }
+    }
+}
+
+typedef unordered_map<unsigned long long, double> distance_hits_t; // stack distance -> hits, only the ones seen
+
+/**
+ * @return vector - the (stack distance, hits) pairs of a histogram in distance order
+ */
+vector<pair<unsigned long long, double>> sorted_hits(const distance_hits_t &hits) {
+    vector<pair<unsigned long long, double>> rows(hits.begin(), hits.end());
+    sort(rows.begin(), rows.end());
+    return rows;
+}
+
+/**
+ * Print the rows of one miss-ratio curve: the faults with F frames are the references minus the hits at stack
+ * distances up to F, so rows are only printed at the distances that have hits
+ * @param refs - references
+ * @param hits - (stack distance, hits) pairs in distance order
+ */
+void print_curve_rows(double refs, const vector<pair<unsigned long long, double>> &hits) {
+    double faults = refs;
+    for (auto &row: hits) {
+        faults -= row.second;
+        printf("%llu %lld\n", row.first, llround(min(refs, max(0.0, faults))));
+    }
+}
+
+/**
+ * Print the global miss-ratio curve followed by the curve of every process
+ * @param refs - references per process
+ * @param hits - (stack distance, hits) pairs of all processes, in distance order
+ * @param proc_hits - the hits of each process
+ */
+void print_miss_ratio_curve(const vector<double> &refs, const vector<pair<unsigned long long, double>> &hits,
+                            const vector<distance_hits_t> &proc_hits) {
+    double total_refs = 0;
+    for (double count: refs) total_refs += count;
+    printf("FRAMES FAULTS\n");
+    print_curve_rows(total_refs, hits);
+    for (int pid = 0; pid < NUM_PROCS; pid++) {
+        printf("PROC[%d] REFS=%.0f\n", pid, refs[pid]);
+        print_curve_rows(refs[pid], sorted_hits(proc_hits[pid]));
+    }
+}
+
+/**
+ * Print the faults of global LRU replacement for every number of frames, from one pass over the instructions
+ * A reference faults with F frames if its stack distance is 0 or above F. Pages of an exited process leave
+ * the stack; the curve is exact (matching -a l) for traces without exits.
+ * The global histogram is dense in the stack distance, the per-process ones only hold the distances they hit.
+ */
+void print_lru_miss_ratio_curve() {
+    StackDistances stack;
+    vector<double> refs(NUM_PROCS, 0);
+    vector<unsigned long long> hits;                // hits[d]: references at stack distance d
+    vector<distance_hits_t> proc_hits(NUM_PROCS);
+
+    for_each_reference([&](int pid, vpage_t vpage) {
+        refs[pid]++;
+        unsigned long long distance = stack.access(page_key(pid, vpage));
+        if (distance == 0) return;
+        if (hits.size() <= distance) hits.resize(distance + 1, 0);
+        hits[distance]++;
+        proc_hits[pid][distance]++;
+    }, [&](int pid) {
+        stack.remove_process(pid);
+    });
+
+    vector<pair<unsigned long long, double>> rows;
+    for (unsigned long long d = 1; d < hits.size(); d++)
+        if (hits[d] != 0) rows.emplace_back(d, (double) hits[d]);
+
+    double total_refs = 0;
+    for (double count: refs) total_refs += count;
+    printf("MRC LRU REFS=%.0f\n", total_refs);
+    print_miss_ratio_curve(refs, rows, proc_hits);
+}
+
+/**
+ * Print an approximate LRU miss-ratio curve from a spatially hashed sample of the pages (SHARDS)
+ * A page is sampled if its hash is below a threshold T, giving a sampling rate R = T / SHARDS_MODULUS; a
+ * sampled reference stands for 1 / R references at R times its stack distance. Once more than
+ * SHARDS_MAX_PAGES pages are sampled, the page with the largest hash is dropped and T lowered to its hash,
+ * which bounds memory regardless of the trace size. The faults start from the exact reference count, so the
+ * difference to the estimated references lands in the cold misses (SHARDS-adj), and are kept within [0, refs].
+ */
+void print_sampled_miss_ratio_curve() {
+    StackDistances stack;
+    set<pair<unsigned long long, unsigned long long>> sampled; // (hash, page) of the sampled pages
+    unsigned long long threshold = SHARDS_MODULUS;
+    unsigned long long sampled_refs = 0;
+    vector<double> refs(NUM_PROCS, 0);
+    distance_hits_t hits;
+    vector<distance_hits_t> proc_hits(NUM_PROCS);
+
+    for_each_reference([&](int pid, vpage_t vpage) {
+        refs[pid]++;
+        unsigned long long key = page_key(pid, vpage);
+        unsigned long long hash = key + 0x9e3779b97f4a7c15ULL;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        hash = (hash ^ (hash >> 31)) % SHARDS_MODULUS;
+        if (hash >= threshold) return;
+
+        sampled_refs++;
+        double scale = (double) SHARDS_MODULUS / (double) threshold;
+        unsigned long long distance = stack.access(key);
+        if (distance == 0) {
+            sampled.emplace(hash, key);
+            while (sampled.size() > SHARDS_MAX_PAGES) {
+                threshold = prev(sampled.end())->first;
+                while (!sampled.empty() && prev(sampled.end())->first == threshold) {
+                    stack.remove(prev(sampled.end())->second);
+                    sampled.erase(prev(sampled.end()));
+                }
+            }
+            return;
+        }
+
+        unsigned long long scaled_distance = max(1LL, llround((double) distance * scale));
+        hits[scaled_distance] += scale;
+        proc_hits[pid][scaled_distance] += scale;
+    }, [&](int pid) {
+        stack.remove_process(pid);
+        for (auto it = sampled.begin(); it != sampled.end();) {
+            if ((int) (it->second >> VPAGE_BITS) == pid) it = sampled.erase(it);
+            else ++it;
+        }
+    });
+
+    double total_refs = 0;
+    for (double count: refs) total_refs += count;
+    printf("MRC SHARDS REFS=%.0f SAMPLED=%llu RATE=%g\n", total_refs, sampled_refs,
+           (double) threshold / (double) SHARDS_MODULUS);
+    print_miss_ratio_curve(refs, sorted_hits(hits), proc_hits);
+}
+
 /**
  * Debug function to pretty print the input tokens
  */
 [[maybe_unused]] void print_input() {
     printf("NUM_FRAMES = %d\n", NUM_FRAMES);
     printf("NUM_PROCESSES = %d\n", NUM_PROCS);
-    for (Process *p: PROCS) {
-        printf("PROCESS %d\n", p->get_pid());
-        printf("\tNUM VMAS = %d\n", p->num_vmas);
-        for (vma_t vma: p->vma_list) {
-            printf("\t\t %d : %d : %d : %d\n", vma.start_page, vma.end_page, vma.is_write_protected,
-                   vma.is_file_mapped);
+    for (int pid = 0; pid < NUM_PROCS; pid++) {
+        printf("PROCESS %d\n", pid);
+        printf("\tNUM VMAS = %d\n", (int) PROC_VMAS[pid].size());
+        for (vma_t vma: PROC_VMAS[pid]) {
+            printf("\t\t %llu : %llu : %d : %d\n", (unsigned long long) vma.start_page,
+                   (unsigned long long) vma.end_page, (int) vma.is_write_protected, (int) vma.is_file_mapped);
         }
     }
     printf("INSTRUCTIONS\n");
     for (ins_t ins: INSTRUCTIONS) {
-        printf("\t%c : %d\n", ins.op, ins.addr);
+        printf("\t%c : %lld\n", ins.op, (long long) ins.addr);
+    }
+}
+
+/**
+ * Print a single page table entry
+ */
+void Simulator::print_pte(vpage_t vpage, const pte_t &entry) const {
+    if (entry.is_present) {
+        printf("%lld:", vpage);
+        is_frame_referenced(entry.frame_num) ? printf("R") : printf("-");
+        is_frame_modified(entry.frame_num) ? printf("M") : printf("-");
+        entry.is_paged_out ? printf("S") : printf("-");
+    } else {
+        entry.is_paged_out ? printf("#") : printf("*");
     }
 }
 
 /**
  * Print the page table for each process after executing all the instructions
+ * The first PT_PRINT_VPAGES entries are always listed, higher vpages only if they are present
+ * or paged out, as "<vpage>:<flags>" or "<vpage>:#"
  */
-void print_page_tables() {
-    for (Process *p: PROCS) {
+void Simulator::print_page_tables() {
+    for (Process *p: procs) {
+        // entries worth printing: present or paged out
+        vector<pair<vpage_t, pte_t>> entries;
+        if (ipt != nullptr) {
+            for (frame_t &frame: frame_table)
+                if (frame.is_assigned && frame.pid == p->get_pid())
+                    entries.emplace_back(frame.vpage, *frame.pte);
+            pte_t swapped{};
+            swapped.is_paged_out = true;
+            for (vpage_t vpage: ipt->swapped_pages(p->get_pid()))
+                entries.emplace_back(vpage, swapped);
+            sort(entries.begin(), entries.end(),
+                 [](const pair<vpage_t, pte_t> &a, const pair<vpage_t, pte_t> &b) { return a.first < b.first; });
+        } else {
+            p->page_table.for_each([&entries](vpage_t vpage, pte_t *entry) {
+                if (entry->is_present || entry->is_paged_out)
+                    entries.emplace_back(vpage, *entry);
+            });
+        }
+
         printf("PT[%d]: ", p->get_pid());
-        for (int i = 0; i < MAX_VPAGES; i++) {
-            pte_t entry = p->page_table[i];
-            if (entry.is_present) {
-                printf("%d:", i);
-                entry.is_referenced ? printf("R") : printf("-");
-                entry.is_modified ? printf("M") : printf("-");
-                entry.is_paged_out ? printf("S") : printf("-");
-            } else {
-                entry.is_paged_out ? printf("#") : printf("*");
-            }
-            if (i != MAX_VPAGES - 1) printf(" ");
+        size_t next = 0;
+        for (int i = 0; i < PT_PRINT_VPAGES; i++) {
+            if (next < entries.size() && entries[next].first == i)
+                print_pte(i, entries[next++].second);
+            else
+                printf("*");
+            if (i != PT_PRINT_VPAGES - 1) printf(" ");
+        }
+        for (; next < entries.size(); next++) {
+            printf(" ");
+            if (!entries[next].second.is_present) printf("%lld:", entries[next].first);
+            print_pte(entries[next].first, entries[next].second);
         }
         printf("\n");
     }
@@ -922,12 +4102,12 @@ void print_page_tables() {
 /**
  * Print the final value of the frame table after
  */
-void print_frame_table() {
+void Simulator::print_frame_table() {
     printf("FT: ");
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        frame_t *frame = &FRAME_TABLE[i];
-        frame->is_assigned ? printf("%d:%d", frame->pid, frame->vpage) : printf("*");
-        if (i != NUM_FRAMES - 1) printf(" ");
+    for (int i = 0; i < num_frames; i++) {
+        frame_t *frame = &frame_table[i];
+        frame->is_assigned ? printf("%d:%lld", frame->pid, frame->vpage) : printf("*");
+        if (i != num_frames - 1) printf(" ");
     }
     printf("\n");
 }
@@ -935,8 +4115,8 @@ void print_frame_table() {
 /**
  * Print the per process stats
  */
-void print_per_process_stats() {
-    for (Process *proc: PROCS) {
+void Simulator::print_per_process_stats() {
+    for (Process *proc: procs) {
         printf("PROC[%d]: U=%llu M=%llu I=%llu O=%llu FI=%llu FO=%llu Z=%llu SV=%llu SP=%llu\n",
                proc->get_pid(),
                proc->unmaps, proc->maps, proc->ins, proc->outs,
@@ -945,15 +4125,78 @@ void print_per_process_stats() {
     }
 }
 
-void print_global_stats() {
+void Simulator::print_global_stats() {
     printf("TOTALCOST %llu %llu %llu %llu %llu\n",
-           INS_COUNTER, CTX_SWITCHES, PROC_EXITS, COST, sizeof(pte_t));
+           ins_counter, ctx_switches, proc_exits, cost, sizeof(pte_t));
+}
+
+/**
+ * @return string - the results of the simulation as a sweep CSV row
+ */
+string Simulator::sweep_row(const string &pager_args, const string &frames) const {
+    unsigned long long unmaps = 0, maps = 0, ins = 0, outs = 0, fins = 0, fouts = 0, zeros = 0, segv = 0;
+    unsigned long long segprot = 0;
+    for (Process *proc: procs) {
+        unmaps += proc->unmaps;
+        maps += proc->maps;
+        ins += proc->ins;
+        outs += proc->outs;
+        fins += proc->fins;
+        fouts += proc->fouts;
+        zeros += proc->zeros;
+        segv += proc->segv;
+        segprot += proc->segprot;
+    }
+    // the pager and frame arguments were validated, so they are a few characters each
+    char row[512];
+    snprintf(row, sizeof(row), "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+             pager_args.c_str(), frames.c_str(), ins_counter, ctx_switches, proc_exits, cost,
+             unmaps, maps, ins, outs, fins, fouts, zeros, segv, segprot);
+    return row;
+}
+
+/**
+ * Run every (pager, frames) configuration of the sweep on the loaded trace and print one CSV row each
+ * Up to NUM_THREADS threads take the configurations in turn, each running them on a Simulator of its own
+ * over the shared trace; with -s every running configuration streams the trace separately. Rows are printed
+ * in configuration order; the output options do not apply.
+ */
+void run_sweep() {
+    vector<pair<string, string>> configs;
+    for (const string &pager: SWEEP_PAGERS)
+        for (const string &frames: SWEEP_FRAMES)
+            configs.emplace_back(pager, frames);
+
+    // the simulations would interleave their traces on stdout
+    VERBOSE = false;
+    SHOW_AGING_INFO = false;
+
+    vector<string> rows(configs.size());
+    atomic<size_t> next_config(0);
+    auto run_configs = [&]() {
+        for (size_t idx = next_config++; idx < configs.size(); idx = next_config++) {
+            Simulator sim(parse_num_frames(configs[idx].second.c_str()), configs[idx].first.c_str());
+            sim.quiet = true;
+            sim.run_simulation();
+            rows[idx] = sim.sweep_row(configs[idx].first, configs[idx].second);
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < NUM_THREADS && i < (int) configs.size(); i++)
+        workers.emplace_back(run_configs);
+    for (thread &worker: workers)
+        worker.join();
+
+    printf("PAGER,FRAMES,INSTRUCTIONS,CTX_SWITCHES,EXITS,COST,UNMAPS,MAPS,INS,OUTS,FINS,FOUTS,ZEROS,SEGV,SEGPROT\n");
+    for (const string &row: rows)
+        printf("%s", row.c_str());
 }
 
 /**
  * Print the final desired output based on global flags
  */
-void print_output() {
+void Simulator::print_output() {
     if (SHOW_PAGE_TABLE)
         print_page_tables();
     if (SHOW_FRAME_TABLE)
@@ -961,24 +4204,36 @@ void print_output() {
     if (SHOW_STATS) {
         print_per_process_stats();
         print_global_stats();
+        pager->print_stats();
     }
 }
 
-void garbage_collection() {
-    delete PAGER;
-
-    for (Process *p: PROCS)
-        delete p;
-}
-
 int main(int argc, char **argv) {
     read_arguments(argc, argv);
+    if (CONVERT_OUTPUT != nullptr) {
+        convert_trace(argv[optind], CONVERT_OUTPUT);
+        return 0;
+    }
     if (argc > optind + 1) {
         parse_randoms(argv[optind + 1]);
     }
     load_input(argv[optind]);
-    initialize_frames();
-    run_simulation();
-    print_output();
-    garbage_collection();
+    if (!SWEEP_PAGERS.empty()) {
+        run_sweep();
+        return 0;
+    }
+    if (MRC_MODE != 0) {
+        if (MRC_MODE == 'e')
+            print_lru_miss_ratio_curve();
+        else
+            print_sampled_miss_ratio_curve();
+        return 0;
+    }
+    if (PAGER_ARGS == nullptr) {
+        printf("replacement algorithm not supplied\n");
+        exit(1);
+    }
+    Simulator sim(NUM_FRAMES, PAGER_ARGS);
+    sim.run_simulation();
+    sim.print_output();
 }
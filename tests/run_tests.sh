@@ -0,0 +1,135 @@
+#!/bin/bash
+# Regression checks for the pagers
+# Usage: tests/run_tests.sh [mmu binary], builds mmu.cpp when no binary is given
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+MMU="$1"
+if [ -z "$MMU" ]; then
+    MMU="$WORK/mmu"
+    g++ -O2 -std=c++17 -pthread -o "$MMU" "$ROOT/mmu.cpp" || exit 1
+fi
+RFILE="$ROOT/rfile"
+FAILED=0
+
+fail() {
+    echo "FAIL: $*"
+    FAILED=1
+}
+
+# CLOCK-Pro with 64K frames: a 64000-page working set interleaved with a scan of pages never used again.
+# Every scanned page ends its test period unreferenced, cold_target drops to 1 and the ring fills with hot
+# and test pages, which HAND_cold must not walk on every fault.
+awk 'BEGIN {
+    print 1; print 1; print "0 1048575 0 0"; print "c 0"
+    scan = 100000
+    for (i = 0; i < 800000; i++) {
+        if (i % 5 < 3) p = (i * 7919) % 64000; else p = scan++
+        print ((i % 3) ? "r " : "w ") p
+    }
+}' > "$WORK/scan"
+if ! timeout 20 "$MMU" -f65536 -aP -oS "$WORK/scan" "$RFILE" | grep -q '^TOTALCOST 800001 '; then
+    fail "clock-pro with a small cold share did not finish within 20s"
+fi
+
+# PFF with 30 frames: process 0 cycles over 40 pages and always faults above PFF_UPPER, process 1 cycles
+# over 4 pages. Process 1 must get its 4 frames from process 0 instead of thrashing in a single frame.
+awk 'BEGIN {
+    print 2
+    for (p = 0; p < 2; p++) { print 1; print "0 63 0 0" }
+    for (i = 0; i < 600; i++) {
+        print "c 0"; for (j = 0; j < 30; j++) print "r " (i * 30 + j) % 40
+        print "c 1"; for (j = 0; j < 30; j++) print "r " j % 4
+    }
+}' > "$WORK/pff"
+"$MMU" -f30 -aF -oS "$WORK/pff" "$RFILE" > "$WORK/pff.out"
+if ! grep -q '^PFF PROC\[1\]: FRAMES=4 ' "$WORK/pff.out"; then
+    fail "pff left the small working set without its frames"
+fi
+PROC1_FAULTS=$(sed -n 's/^PROC\[1\]: .* M=\([0-9]*\) .*/\1/p' "$WORK/pff.out")
+if [ -z "$PROC1_FAULTS" ] || [ "$PROC1_FAULTS" -gt 100 ]; then
+    fail "pff gave the small working set ${PROC1_FAULTS:-no} faults, expected at most 100"
+fi
+
+# A VMA bound past the 2^36 vpages must be rejected rather than cut down to a different range
+printf '1\n1\n0 68719476736 0 0\nc 0\nr 5\n' > "$WORK/vma"
+if "$MMU" -f4 -ac "$WORK/vma" "$RFILE" > /dev/null; then
+    fail "a VMA ending past the largest vpage was accepted"
+fi
+
+# Working set with 100 frames over three processes: the indexed victim search must pick the same frames as the
+# frame-by-frame scan that -oa prints
+awk 'BEGIN {
+    print 3
+    for (p = 0; p < 3; p++) { print 2; print "0 199 0 0"; print "200 511 " (p == 1) " " (p == 2) }
+    x = 12345
+    for (i = 0; i < 60000; i++) {
+        if (i % 40 == 0) print "c " (i / 40) % 3
+        x = (x * 1103515245 + 12345) % 2147483648
+        if (x % 4) pg = x % 120; else pg = 200 + x % 312
+        print ((x % 7 < 5) ? "r " : "w ") pg
+    }
+}' > "$WORK/ws"
+"$MMU" -f100 -aw -oFS "$WORK/ws" "$RFILE" > "$WORK/ws.indexed"
+"$MMU" -f100 -aw -oFSa "$WORK/ws" "$RFILE" | grep -v '^ASELECT' > "$WORK/ws.scanned"
+if ! cmp -s "$WORK/ws.indexed" "$WORK/ws.scanned"; then
+    fail "working set picks different victims with and without -oa"
+fi
+
+# A trace converted with -C must simulate exactly like the text it came from, loaded whole or streamed with -s
+awk 'BEGIN {
+    print "# generated round-trip trace"
+    print 3
+    for (p = 0; p < 3; p++) { print "# process " p; print 2; print "0 99 " (p == 1) " 0"; print "100 1000000 0 " (p != 1) }
+    x = 777
+    for (i = 0; i < 20000; i++) {
+        if (i % 50 == 0) print "c " (i / 50) % 3
+        x = (x * 1103515245 + 12345) % 2147483648
+        if (x % 3) pg = x % 100; else pg = 100 + x % 999901
+        print ((x % 5 < 3) ? "r " : "w ") pg
+    }
+    print "c 2"; print "e 2"
+}' > "$WORK/rt"
+if ! "$MMU" -C "$WORK/rt.vmt" "$WORK/rt" > /dev/null; then
+    fail "converting a text trace with -C failed"
+fi
+"$MMU" -f16 -ac -oOPFS "$WORK/rt" "$RFILE" > "$WORK/rt.text"
+for MODE in "" "-s"; do
+    for TRACE in rt rt.vmt; do
+        if ! "$MMU" -f16 -ac -oOPFS $MODE "$WORK/$TRACE" "$RFILE" | cmp -s "$WORK/rt.text" -; then
+            fail "$TRACE ${MODE:+with $MODE }does not simulate like the text trace"
+        fi
+    done
+done
+
+# A trace with runs of references to the same and nearby pages must convert to a tenth of its text or less,
+# and its repeat records must still simulate like the text
+awk 'BEGIN {
+    print 2
+    for (p = 0; p < 2; p++) { print 1; print "0 65535 0 0" }
+    x = 99; pg = 10000; n = 0
+    for (i = 0; i < 100000; ) {
+        if (n++ % 200 == 0) print "c " n % 2
+        x = (x * 1103515245 + 12345) % 2147483648; y = int(x / 65536)
+        if (y % 20 == 0) pg = 10000 + y % 50000; else pg += y % 5 - 1
+        op = (y % 3) ? "r " : "w "
+        for (k = y % 8; k >= 0; k--) { print op pg; i++ }
+    }
+}' > "$WORK/local"
+"$MMU" -C "$WORK/local.vmt" "$WORK/local" > /dev/null
+TEXT_SIZE=$(wc -c < "$WORK/local")
+VMT_SIZE=$(wc -c < "$WORK/local.vmt")
+if [ $((VMT_SIZE * 10)) -gt "$TEXT_SIZE" ]; then
+    fail "a local trace of $TEXT_SIZE bytes converted to $VMT_SIZE bytes, expected at most a tenth"
+fi
+"$MMU" -f16 -ac -oOPFS "$WORK/local" "$RFILE" > "$WORK/local.text"
+for MODE in "" "-s"; do
+    if ! "$MMU" -f16 -ac -oOPFS $MODE "$WORK/local.vmt" "$RFILE" | cmp -s "$WORK/local.text" -; then
+        fail "local.vmt ${MODE:+with $MODE }does not simulate like the text trace"
+    fi
+done
+
+[ $FAILED -eq 0 ] && echo "all tests passed"
+exit $FAILED